@@ -2,16 +2,99 @@
 #define _ANALYSIS_
 
 #include "StatTrie.h"
+#include "QuantileSketch.h"
+#include "TaskPool.h"
+#include <cstdint>
+#include <memory>
+#include <string_view>
+
+
+// Flags of EntryTable::categories
+enum AnomalyCategory : uint8_t {
+    FREQ_ANOMALY    = 1,
+    LEN_ANOMALY     = 2,
+    ENTROPY_ANOMALY = 4
+};
 
 
-struct AnomalyEntry {
-    std::string word;
-    unsigned count;
-    double freqRate;
-    double entropy;
-    unsigned depth;
-    double score; // tổng hợp multi-metric
-    bool isWord;
+/**
+ * @brief One column of an EntryTable: a vector of its own, or a view into the dump mapping that
+ * Analysis::load() leaves in the table. The mapping is private, so writing through a view copies
+ * the touched page, never the file; growing or shrinking a view first copies it into a vector.
+ */
+template <typename T>
+class Column {
+    std::vector<T> values;
+    T* view = nullptr;     // first value of the view, nullptr for owned values
+    size_t viewSize = 0;
+
+    void own() {
+        if (!view) return;
+        values.assign(view, view + viewSize);
+        view = nullptr;
+    }
+
+public:
+    using value_type = T;
+
+    Column() = default;
+    Column(std::vector<T> &&owned) : values(std::move(owned)) {}
+
+    size_t size() const { return view ? viewSize : values.size(); }
+    bool empty() const { return size() == 0; }
+    T* data() { return view ? view : values.data(); }
+    const T* data() const { return view ? view : values.data(); }
+    T* begin() { return data(); }
+    T* end() { return data() + size(); }
+    const T* begin() const { return data(); }
+    const T* end() const { return data() + size(); }
+    T& operator[](size_t i) { return data()[i]; }
+    const T& operator[](size_t i) const { return data()[i]; }
+
+    void push_back(const T &value) { own(); values.push_back(value); }
+    void append(const T* first, size_t n) { own(); values.insert(values.end(), first, first + n); }
+    void resize(size_t n) { own(); values.resize(n); }
+    void clear() {
+        view = nullptr;
+        viewSize = 0;
+        values.clear();
+    }
+    // n values at first, which must outlive the column's use of them
+    void setView(T* first, size_t n) {
+        std::vector<T>().swap(values);
+        view = first;
+        viewSize = n;
+    }
+};
+
+
+/**
+ * @brief Statistics of every entry, one array per field (struct of arrays).
+ * An entry is a prefix (node with positive local entropy) or a word (node where words end);
+ * a node that is both gives two entries sharing the same word and node id.
+ * Words are stored once in a shared pool. After Analysis::load() the columns are views into the
+ * mapped dump, which the table keeps until it is cleared or destroyed.
+ */
+struct EntryTable {
+    Column<unsigned> counts;
+    Column<unsigned> depths;
+    Column<unsigned> lenFreqs;    // frequency of the entry's length, 0 for prefixes
+    Column<double> entropies;
+    Column<double> freqRates;
+    Column<uint8_t> isWord;       // kind: 1 word, 0 prefix
+    Column<uint32_t> nodeIds;     // preorder rank of the node: lower than its descendants', each subtree a contiguous range
+    Column<uint8_t> categories;   // AnomalyCategory flags
+    Column<size_t> wordOffsets;   // word of entry i: wordPool[wordOffsets[i], +wordLengths[i])
+    Column<uint32_t> wordLengths;
+    Column<char> wordPool;
+    std::shared_ptr<void> mapping; // the dump the columns view, if loaded
+
+    size_t size() const;
+    std::string_view word(size_t i) const;
+    void clear();
+    void resize(size_t n);  // columns only, not the word pool
+    // Reorder every column so that new entry i is old entry order[i]
+    void permute(const std::vector<uint32_t> &order, const TaskPool &pool);
 };
 
 
@@ -28,11 +111,15 @@ class Analysis {
 private:
 
     const StatTrie* trie;
+    TaskPool pool;
     // unordered_set<const StatTrie::Node*> anomalyNodes;
-    std::vector<AnomalyEntry> allEntries;
-    std::vector<AnomalyEntry> freqAnomalies;
-    std::vector<AnomalyEntry> lenAnomalies;
-    std::vector<AnomalyEntry> entropyAnomalies;
+    EntryTable entries;                    // sorted by word, prefix before word
+    std::vector<uint32_t> freqAnomalies;   // entry indices, rarest first (only the topK rarest in top-K mode)
+    std::vector<uint32_t> lenAnomalies;
+    std::vector<uint32_t> entropyAnomalies;
+    std::vector<uint32_t> rankedFreq;      // words by (count, word), built by the first reclassify()
+    std::vector<uint32_t> rankedLen;       // words by (length frequency, word)
+    std::vector<uint32_t> rankedEntropy;   // prefixes by (entropy descending, word)
     
     double freqPercentile;
     double entropyPercentile;
@@ -46,6 +133,11 @@ private:
     unsigned totalUniqueWords;
     unsigned totalNodes;
     unsigned totalUniqueWordChar;
+    unsigned totalSymbols; // interned tokens, 0 in character mode
+    unsigned totalContainers;
+    unsigned totalContainerEntries;
+    unsigned burstThreshold; // of the analysed trie
+    bool tokenMode;
     
     unsigned maxFreq;
     unsigned minFreq;
@@ -54,18 +146,29 @@ private:
     double maxEntropy;
     double minEntropy;
     std::unordered_map<unsigned, unsigned> lenFreq;
+    QuantileSketch freqSketch;    // word frequencies, filled during the traversal
+    QuantileSketch entropySketch; // prefix entropies, filled during the traversal
 
     double freqAnomaliesRate;
     double lenAnomaliesRate;
     double entropyAnomaliesRate;
+    size_t totalFreqAnomalies;
+    size_t totalLenAnomalies;
+    size_t totalEntropyAnomalies;
+    size_t topK; // 0: keep every anomaly
     
-    double computeLocalEntropy(const Node* node);
+    // traversal tasks cover at most 1/TASK_GRAIN of the inserted words each
+    static constexpr unsigned TASK_GRAIN = 256;
+
+    double computeLocalEntropy(const Node* node) const;
     void computePercentileThresholds();
+    void refillSketches();  // from the entries, in entry order
     void getExtremum();
     void detectAnomalies();
+    void rankEntries();
 
-    std::string escapeCSV(const std::string& s) const;
-    void writeCSVToFilestream (std::ofstream& file, const std::vector<AnomalyEntry>& anomalies) const;
+    std::string escapeCSV(std::string_view s) const;
+    void writeCSVRow (std::ofstream& file, size_t i) const;
     // void exportJSON(const StatTrie &_trie, const string exportFile = "data/output/trie.json") const;
 
 
@@ -73,9 +176,37 @@ private:
 
     Analysis(double freqPercentile = 5, double lenPercentile = 5, double entropyPercentile = 95);
 
+    // Percentiles are exact (selection) up to this many values, KLL sketch estimates beyond
+    void setQuantileExactLimit(size_t limit);
+    // Worker threads for collectStatistics, 0: one per hardware thread (results do not depend on it)
+    void setThreads(unsigned threads);
+    // Keep only the k rarest anomalies per metric (bounded heap instead of a full sort), 0: keep all.
+    // Totals and rates in the report still cover every anomaly.
+    void setTopK(size_t k);
+
     void collectStatistics(const StatTrie* _trie);
+    // Recompute only the thresholds and the length histogram of a (grown) trie, much cheaper than
+    // collectStatistics; the entry table and anomaly lists are left as they were (stream mode)
+    void refreshThresholds(const StatTrie* _trie);
+    // Binary snapshot of the collected state (entries, histogram, thresholds, extrema, anomaly
+    // indices). load() maps the file and restores everything the exports need, so reports and
+    // CSVs can be regenerated without the input or the trie; false on error.
+    bool dump(const std::string &file) const;
+    bool load(const std::string &file);
+    // Rebuild a trie from the word entries of a loaded state (for the JSON exports) and attach it.
+    // target must be empty; symbols is used in token mode.
+    void rebuildTrie(StatTrie &target, SymbolTable &symbols);
+
+    // Recompute thresholds and anomaly sets for new percentiles from the collected statistics
+    void reclassify(double freqP, double lenP, double entropyP);
     void markAnomalyNodes(std::unordered_set<const Node*> &anomalyNodes, const char mode = 'a') const;
 
+    // Thresholds and length histogram of the last classification, for scoring new lines
+    double frequencyThreshold() const;
+    double lengthFrequencyThreshold() const;
+    double localEntropyThreshold() const;
+    const std::unordered_map<unsigned, unsigned>& lengthFrequencies() const;
+
     // xuất report, json, csv
     // void report(const std::string directory = "data/output") const;
     void exportReport(const std::string exportFile = "data/output/overall_report.txt") const;
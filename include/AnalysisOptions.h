@@ -0,0 +1,67 @@
+#ifndef _ANALYSISOPTIONS_
+#define _ANALYSISOPTIONS_
+
+#include "Analysis.h"
+#include "SymbolTable.h"
+#include <string>
+#include <vector>
+
+
+// JSON exports, written to the output directory
+const std::string FN_JSON_COMPLETE = "complete_trie.json";
+const std::string FN_JSON_PARTIAL  = "partial_trie.json";
+const std::string FN_JSON_FREQ     = "frequency_anomalies.json";
+const std::string FN_JSON_LEN      = "length_anomalies.json";
+const std::string FN_JSON_ENTROPY  = "entropy_anomalies.json";
+
+
+/**
+ * @brief Settings of the analysis step, shared by bin/analyze and main_pipeline.
+ * parse() takes the analysis flags (percentiles, trie mode, dump, sweep, JSON exports) and
+ * keeps them as given, so that main_pipeline --spawn can pass them on to bin/analyze;
+ * runAnalysis() then drives the Analysis over a built trie and writes every output.
+ */
+struct AnalysisOptions {
+
+    double percFreq = 5.0;       // low
+    double percLen = 5.0;        // low
+    double percEntropy = 95.0;   // high
+    size_t exactLimit = QuantileSketch::DEFAULT_EXACT_LIMIT;
+    unsigned threads = 0;
+    size_t topK = 0;
+    std::string dumpFile;
+    std::vector<std::vector<double>> sweeps;  // percentile triples (freq, len, entropy)
+    std::vector<std::string> sweepLabels;     // "<f>_<l>_<e>" as typed
+
+    bool tokenMode = false;
+    unsigned burstThreshold = 0;
+    bool compact = false;
+    bool verifyEntropy = false;
+
+    bool jsonComplete = false;
+    bool jsonPartial = false;
+    bool jsonFreq = false;
+    bool jsonLen = false;
+    bool jsonEntropy = false;
+
+    std::vector<std::string> flags;  // the flags taken by parse, as given
+
+    // 1 if arg is an analysis flag and was taken, 0 if it is not one, -1 on a bad value (reported)
+    int parse (const std::string &arg);
+    bool wantsJSON() const;
+
+    // Thresholds and settings of a, which must have been built with the three percentiles
+    void configure (Analysis &a) const;
+    // Burst containers or token mode over symbols for an empty trie; false (reported) if both
+    bool configure (StatTrie &trie, SymbolTable &symbols) const;
+};
+
+
+// Statistics of a built trie (after --compact and --verify-entropy), then every output;
+// false (reported) on failure
+bool runAnalysis (const AnalysisOptions &options, StatTrie &trie, Analysis &a, const std::string &outputDir);
+// Outputs of an Analysis already collected or loaded: dump, report, CSVs, JSONs, sweep reports
+bool exportAnalysis (const AnalysisOptions &options, StatTrie &trie, Analysis &a, const std::string &outputDir);
+
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef _ARRAYHASH_
+#define _ARRAYHASH_
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <functional>
+
+
+/**
+ * @brief Cache-conscious array hash used as a burst-trie container.
+ * Keys are hashed into a small fixed number of slots; each slot is one contiguous
+ * byte array of packed records [uint32 length][key bytes][uint32 count], so a probe
+ * is a linear scan through a single allocation instead of chasing per-key pointers.
+ */
+class ArrayHash {
+
+    private:
+
+    std::vector<std::string> slots;
+    size_t countEntries;  // number of distinct keys
+    unsigned countTotal;  // sum of all counts
+
+    static uint32_t hash (std::string_view key);
+    std::string& slotOf (std::string_view key);
+    const std::string& slotOf (std::string_view key) const;
+    static size_t findRecord (const std::string& slot, std::string_view key);
+
+
+    public:
+
+    static constexpr size_t DEFAULT_SLOTS = 8;
+
+    ArrayHash (size_t slotCount = DEFAULT_SLOTS);
+
+    bool add (std::string_view key, unsigned num);  // true if key was not present
+    unsigned find (std::string_view key) const;     // 0 if absent
+    unsigned erase (std::string_view key);          // count removed, 0 if absent
+    bool hasPrefix (std::string_view prefix) const;
+
+    size_t size() const;
+    unsigned totalCount() const;
+    size_t memoryUsage() const;
+
+    void forEach (const std::function<void(std::string_view, unsigned)> &callback) const;
+    // Entries sorted by key; views point into the container and die with the next update
+    std::vector<std::pair<std::string_view, unsigned>> sortedEntries() const;
+};
+
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef _ENTROPY_
+#define _ENTROPY_
+
+#include <cstddef>
+
+
+/**
+ * @brief Entropy kernel on integer counts.
+ * Local entropy is evaluated as H = log2(N) - (1/N) * sum(c*log2(c)), so a node only needs
+ * the running sum of c*log2(c) over its outcomes. c*log2(c) comes from a precomputed table
+ * for small counts and from a table-assisted log2 approximation for large ones.
+ */
+namespace entropy {
+
+    constexpr unsigned TABLE_SIZE = 1 << 11;
+
+    extern double nlog2nTable[TABLE_SIZE]; // c*log2(c) for c < TABLE_SIZE
+
+    double fastLog2 (double x);  // x >= 1, relative error below 1e-14
+
+    inline double nlog2n (unsigned c) {
+        return c < TABLE_SIZE ? nlog2nTable[c] : c * fastLog2 (c);
+    }
+
+    // sum(c*log2(c)) over gathered counts, eight at a time with AVX2 when the CPU has it
+    double sumNLog2N (const unsigned* counts, size_t n);
+
+    // H from the total count and the sum(c*log2(c)) of its outcomes
+    double localEntropy (unsigned total, double sumNLog2N);
+    // H of a distribution given by its counts
+    double localEntropy (const unsigned* counts, size_t n);
+
+    bool hasAVX2();
+}
+
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef _LINEREADER_
+#define _LINEREADER_
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+
+
+/**
+ * @brief Reads a file line by line without copying it.
+ * Regular files are memory-mapped and every line is handed out as a view into the mapping,
+ * valid until the reader is closed. Lines split on '\n' only, like std::getline.
+ * Other inputs (pipes, "-" for stdin) and compressed inputs, recognized by their magic bytes
+ * (gzip; zstd in builds with SCAD_HAVE_ZSTD), are read (and decompressed) block by block on a
+ * separate thread while the caller works through the lines, so memory stays a few blocks;
+ * their views are valid until the next call.
+ */
+class LineReader {
+
+    private:
+
+    struct Inflater;      // reading (and decompression) thread and its queue of blocks
+
+    const char* data;
+    size_t length;
+    size_t position;
+    size_t scanned;       // streams: bytes after position known to hold no '\n'
+    size_t dropped;       // streams: consumed bytes already erased from buffer
+    bool mapped;          // data is an mmap of length bytes, otherwise it points into buffer
+    std::string buffer;
+    std::unique_ptr<Inflater> inflater;
+
+    bool refill();        // streams: drop the consumed bytes, append the next block
+
+
+    public:
+
+    LineReader();
+    ~LineReader();
+    LineReader (const LineReader&) = delete;
+    LineReader& operator= (const LineReader&) = delete;
+
+    bool open (const std::string &file); // false if the file cannot be read
+    void close();
+
+    // Next line without its '\n'; false at end of input
+    bool next (std::string_view &line);
+    // A whole line is already buffered, so next() returns it without waiting for input
+    bool lineReady() const;
+    // Whole lines of at least size bytes (fewer at the end), '\n' included; false at end of input
+    bool nextBlock (size_t size, std::string_view &block);
+    // Whole content, for callers that split it themselves; a compressed input is decompressed
+    // into memory at once
+    std::string_view content();
+    size_t size() const;
+    // Bytes of input handed out so far (decompressed), newlines included; the input size at its end
+    size_t consumed() const;
+    bool streaming() const; // views only last until the next call
+};
+
+
+#endif
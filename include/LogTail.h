@@ -0,0 +1,76 @@
+#ifndef _LOGTAIL_
+#define _LOGTAIL_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+
+// Where a follower stands: the file it reads and the offset just after the last line handed out
+struct TailPosition {
+    uint64_t device;
+    uint64_t inode;
+    uint64_t offset;
+};
+
+
+/**
+ * @brief Follows a log file that keeps growing, like tail -F: every complete line appended to it
+ * is handed out once, in order. Changes are noticed through inotify (the file and its directory
+ * are watched), or by polling every POLL_MS when inotify is unavailable. A file renamed or removed
+ * and then replaced (rotation) is read to its end, its last line even without '\n', before the
+ * new file is followed from its start; a file that becomes shorter than what was read
+ * (truncation, copytruncate) is followed again from its start.
+ */
+class LogTail {
+
+    private:
+
+    std::string path;
+    int fd;
+    int notify;            // inotify descriptor, -1: polling
+    int fileWatch;         // inotify watch on the followed file, -1 if none
+    TailPosition current;
+    uint64_t readOffset;   // file offset of the end of buffer
+    std::string buffer;    // bytes read and not handed out yet, from start on
+    size_t start;
+    size_t scanned;        // bytes after start known to hold no '\n'
+    std::string lastLine;  // unterminated end of a rotated file, handed out before the new file
+    bool hasLastLine;
+    unsigned rotations;
+    unsigned truncations;
+
+    bool readMore();       // append what the file holds now; false at its end
+    bool checkFile();      // at the end of the file: true if it was truncated or rotated
+    void watchFile();
+
+
+    public:
+
+    static constexpr unsigned POLL_MS = 250;
+
+    LogTail();
+    ~LogTail();
+    LogTail (const LogTail&) = delete;
+    LogTail& operator= (const LogTail&) = delete;
+
+    // Follow file from resume (a position() of an earlier run) if it still names the same file,
+    // at least that long, otherwise from the start; false if the file cannot be opened
+    bool open (const std::string &file, const TailPosition* resume = nullptr);
+    void close();
+
+    // Next complete line already written, without its '\n'; false if there is none yet.
+    // The view is valid until the next call.
+    bool next (std::string_view &line);
+    // Block until the file may have changed, timeoutMs elapsed or a signal arrived
+    void wait (unsigned timeoutMs);
+
+    TailPosition position() const;
+    bool polling() const;
+    unsigned totalRotations() const;
+    unsigned totalTruncations() const;
+};
+
+
+#endif
@@ -2,32 +2,131 @@
 #define PREPROCESSOR_H
 
 #include <string>
+#include <string_view>
+#include <cstdint>
 #include <vector>
 #include <unordered_set>
 #include <unordered_map>
-#include <regex>
+#include <functional>
+#include <istream>
+#include <ostream>
+#include "SymbolTable.h"
+#include "Regex.h"
+#include "LineReader.h"
+#include "TemplateMiner.h"
 using namespace std;    
 
+// What cleanLine does with one input byte
+enum CharAction : uint8_t {
+    CHAR_KEEP,       // copied as is
+    CHAR_LOWER,      // copied lowercased (A-Z when toLower)
+    CHAR_DROP,       // ignored character
+    CHAR_DELIMITER,  // delimiter or '\n': ends the current cleaned line
+    CHAR_SPACE       // ' ': runs collapse to one, dropped at line edges
+};
+
+// Vectorized cleanLine paths, chosen at runtime from the CPU
+enum SIMDLevel : uint8_t {
+    SIMD_NONE,
+    SIMD_SSE42,  // 16 bytes per step
+    SIMD_AVX2    // 32 bytes per step
+};
+
+// Deduplicating stage: distinct lines are interned in a SymbolTable (one character pool and an
+// open-addressing index of ids) next to their counts, so a repeated line costs one hash probe
+class LineCounter {
+private:
+    SymbolTable lines;
+    vector<unsigned> counts; // by line id, ids in order of first appearance
+    size_t totalLines;
+
+public:
+    LineCounter();
+
+    void add(string_view line, unsigned count = 1);
+    size_t size() const;   // distinct lines
+    size_t total() const;  // lines added
+    // Every distinct line once, in order of first appearance, with its count
+    void forEach(const function<void(string_view line, unsigned count)>& sink) const;
+    // "<line>\t<count>" rows, the format analyze --counts reads
+    void write(ostream& out) const;
+};
+
 class Preprocessor {
 private:
     bool toLower;
-    unordered_set<char> ignoredChars;
-    unordered_set<char> delimiters;
+    RegexEngine regexEngine;
+    mutable size_t inputBytes; // input consumed by the last processFile / processFileParallel
+    CharAction actions[256]; // setIgnoredCharacters/setDelimiters compile into this table
+    unsigned char specialLow[2][16] = {}; // nibble lookup of dropped/delimiter bytes for the SIMD paths
 
-    string normalizeWhitespace(const string& s) const;
+    unsigned char fold(unsigned char c) const;
+    void setAction(char c, CharAction action);
+    void compileLookup();
 
 public:
     Preprocessor(bool toLower = true);
 
     void setIgnoredCharacters(const string& chars);
     void setDelimiters(const string& chars);
+    // filterByRegex runs on the built-in automata by default (REGEX_DFA), REGEX_STD forces std::regex
+    void setRegexEngine(RegexEngine engine);
 
     string cleanLine(const string& line) const;
+    // Single pass over line into out (cleared first, its capacity is reused); out is never
+    // longer than line. Cleaned lines are separated by '\n' when delimiters split the line.
+    void cleanLine(string_view line, string& out) const;
+    // Same, on at most the given SIMD level (SIMD_NONE: the scalar reference)
+    void cleanLine(string_view line, string& out, SIMDLevel level) const;
+    static SIMDLevel simdLevel();
+
+    // Token mode: split a cleaned line on whitespace and intern each token
+    vector<Symbol> tokenize(string_view line, SymbolTable& table) const;
+    void tokenize(string_view line, SymbolTable& table, vector<Symbol>& tokens) const;
     
+    // Streaming variants: every non-empty cleaned line (or regex capture) is passed to the sink as
+    // soon as it is produced, in input order, so memory stays O(line). The view is only valid
+    // during the call.
+    using LineSink = function<void(string_view)>;
+    void processStream(istream& in, const LineSink& sink) const;
+    bool processFile(const string& inputFile, const LineSink& sink) const; // false if unreadable
+    // Bytes of input (decompressed) read by the last processFile or processFileParallel, and so
+    // by mineTemplates and writeTemplates, stdin included
+    size_t bytesRead() const;
+    bool filterByRegex(istream& in, const string& pattern, const LineSink& sink) const; // false on a bad pattern
+    bool filterByRegex(LineReader& reader, const string& pattern, const LineSink& sink) const;
+    // Several patterns in one pass: the captures of each line, pattern by pattern, each with its
+    // pattern's index; the same captures as one filterByRegex per pattern
+    using PatternSink = function<void(size_t pattern, string_view capture)>;
+    bool filterByRegex(istream& in, const vector<string>& patterns, const PatternSink& sink) const;
+    bool filterByRegex(LineReader& reader, const vector<string>& patterns, const PatternSink& sink) const;
+    // Template mining in one pass: every cleaned line of inputFile is masked, clustered by miner
+    // and passed to the sink with its template id as soon as it is read; nothing is kept per line.
+    // Ids never change, but a template still gains wildcards while later lines join it, so the
+    // final text of an id is miner.templateOf(id) once the pass is over. False if unreadable.
+    using TemplateSink = function<void(uint32_t templateId, string_view line)>;
+    bool mineTemplates(const string& inputFile, TemplateMiner& miner, const TemplateSink& sink) const;
+    // The final template of every line, in input order, to the sink. The ids (and, with params,
+    // the lines) of the mining pass go to spoolFile and are replayed from there, so memory stays
+    // O(templates) and the input is read once, stdin too. params gets each line's template id
+    // and the values at its variable positions. The spool file is removed.
+    using ParamSink = function<void(uint32_t templateId, const vector<string_view>& values)>;
+    bool writeTemplates(const string& inputFile, TemplateMiner& miner, const string& spoolFile,
+                        const LineSink& sink, const ParamSink& params = nullptr) const;
+
     vector<string> processFile(
         const string& inputFile,
         const string& outputFile = ""
     );
+
+    // Parallel processFile without the returned lines: the input is cut into line-aligned byte
+    // ranges cleaned on a TaskPool of the given size (0: one per hardware thread), written to
+    // outputFile in input order, so the output is the same as processFile's; false on I/O error
+    bool processFileParallel(
+        const string& inputFile,
+        const string& outputFile,
+        unsigned threads = 0
+    );
     
 
     vector<string> filterByRegex(
@@ -35,7 +134,11 @@ public:
         const string& pattern
     );
 
-    void exportCollected(const string& outputFile, vector<string> data); 
+    void exportCollected(const string& outputFile, const vector<string>& data) const;
+    // One collected string and its '\n', lowercased like exportCollected
+    void writeCollected(ostream& out, string_view s) const;
+    // The same lowercasing into out, for callers that use the string rather than write it
+    void foldCollected(string_view s, string& out) const;
 
 };
 
@@ -0,0 +1,58 @@
+#ifndef _QUANTILESKETCH_
+#define _QUANTILESKETCH_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+/**
+ * @brief Streaming percentile estimator.
+ * Values are kept verbatim up to exactLimit and percentiles are then read by selection
+ * (nth_element), giving the same result as sorting. Past that limit the values move into a
+ * KLL sketch: a stack of compactors where level h holds items of weight 2^h and a full
+ * level is sorted and half of it promoted. Compaction is deterministic (the kept half
+ * alternates per level), so equal inputs merged in equal order give equal sketches.
+ * Two sketches can be merged, e.g. one per worker thread.
+ */
+class QuantileSketch {
+
+    private:
+
+    size_t exactLimit;
+    unsigned k;                                 // accuracy parameter of the sketch
+    size_t countValues;                         // values seen (sum of weights)
+    bool exact;
+    std::vector<double> values;                 // exact mode
+    std::vector<std::vector<double>> levels;    // sketch mode, levels[h] has weight 2^h
+    std::vector<uint8_t> offsets;               // per-level parity used by the next compaction
+    std::vector<size_t> capacities;             // per-level capacity for the current height
+
+    void setLevels (size_t count);
+    size_t retained() const;
+    void toSketch();
+    void compress();
+    void compact (size_t level);
+
+
+    public:
+
+    static constexpr size_t DEFAULT_EXACT_LIMIT = 1 << 20;
+    static constexpr unsigned DEFAULT_K = 400;
+
+    QuantileSketch (size_t exactLimit = DEFAULT_EXACT_LIMIT, unsigned k = DEFAULT_K);
+
+    void add (double value);
+    void merge (const QuantileSketch &other);
+    void clear();
+
+    // Value at index (size_t)(percentile/100 * size()) of the sorted values, clamped to the last one
+    double quantile (double percentile);
+
+    size_t size() const;
+    size_t limit() const; // exactLimit
+    bool isExact() const;
+};
+
+
+#endif
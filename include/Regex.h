@@ -0,0 +1,115 @@
+#ifndef _REGEX_
+#define _REGEX_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+
+// Which implementation Regex::search runs
+enum RegexEngine : uint8_t {
+    REGEX_DFA,  // built-in automata, std::regex only for patterns outside their subset
+    REGEX_STD   // always std::regex
+};
+
+
+/**
+ * @brief ECMAScript regex search giving the results of std::regex_search, in linear time for
+ * the subset used on log lines: literals, '.', classes ([a-z], [^...], \d \w \s and their
+ * negations), capturing and (?:...) groups, alternation, * + ? {n,m} (greedy and lazy) and
+ * the assertions ^ $ \b \B. The pattern compiles into an NFA program; a lazily built DFA over
+ * it finds where the leftmost-first match ends, a DFA over the reversed program walks back to
+ * where it starts, and only patterns with capture groups then run a Pike VM over the match
+ * itself. Every search treats its text as the whole subject, like regex_search on a sub-range.
+ * Anything else (backreferences, lookahead, \x escapes, POSIX classes, repeats of a body that
+ * can match empty, ...) runs on std::regex.
+ */
+class Regex {
+
+    private:
+
+    struct Program;   // NFA instructions of one direction
+    struct DFA;       // states built on demand over a program
+
+    std::unique_ptr<Program> program, reversed;
+    std::unique_ptr<DFA> forward, backward;
+    std::regex fallback;
+    bool builtinEngine;
+    bool wholeMatchGroup;  // the pattern is one capture group
+    size_t groupCount;
+
+    static constexpr size_t MAX_BACKTRACK_BITS = 1 << 18;
+
+    // capture scratch, reused between searches
+    std::vector<int> threadPcs[2];
+    std::vector<ptrdiff_t> threadSpans[2];
+    std::vector<ptrdiff_t> threadCurrent;
+    std::vector<std::pair<int, ptrdiff_t>> threadStack; // DFS: pcs, or (-slot - 1, value) to restore a span
+    std::vector<uint32_t> visited;
+    uint32_t generation;
+    std::vector<uint64_t> positionBits; // backtracker: (pc, position) pairs tried
+
+    bool backtrack (std::string_view text, size_t start, size_t end, std::vector<ptrdiff_t> &spans);
+    bool captures (std::string_view text, size_t start, std::vector<ptrdiff_t> &spans);
+
+
+    public:
+
+    Regex();
+    ~Regex();
+    Regex (const Regex&) = delete;
+    Regex& operator= (const Regex&) = delete;
+
+    // false if std::regex rejects the pattern
+    bool compile (const std::string &pattern, RegexEngine engine = REGEX_DFA);
+    bool builtin() const; // the pattern runs on the built-in automata
+    size_t groups() const; // capture groups, without the whole match
+
+    // Leftmost-first match in text; spans[2i] and spans[2i + 1] bound group i (0: the whole
+    // match) as offsets into text, -1 when the group did not take part
+    bool search (std::string_view text, std::vector<ptrdiff_t> &spans);
+
+    friend class RegexSet;
+};
+
+
+/**
+ * @brief Several patterns over the same texts. Their built-in programs are joined into one
+ * alternation whose every branch ends in its own MATCH, and one DFA pass over a text keeps
+ * all the MATCHes reached, telling which patterns match it; only those then search the text
+ * with their own Regex, so the matches are the ones of separate searches. Patterns outside
+ * the built-in subset are always searched.
+ */
+class RegexSet {
+
+    private:
+
+    std::vector<std::unique_ptr<Regex>> regexes;
+    std::unique_ptr<Regex::Program> program;
+    std::unique_ptr<Regex::DFA> dfa;
+    std::vector<size_t> alwaysSearched;
+
+
+    public:
+
+    RegexSet();
+    ~RegexSet();
+    RegexSet (const RegexSet&) = delete;
+    RegexSet& operator= (const RegexSet&) = delete;
+
+    // false if std::regex rejects one of the patterns
+    bool compile (const std::vector<std::string> &patterns, RegexEngine engine = REGEX_DFA);
+    size_t size() const;
+    Regex& pattern (size_t index);
+
+    // Indices of the patterns that may match text (all of those that do), increasing
+    void matching (std::string_view text, std::vector<size_t> &patterns);
+};
+
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef _SCORER_
+#define _SCORER_
+
+#include "Analysis.h"
+#include <string_view>
+#include <vector>
+
+
+struct LineScore {
+    unsigned frequency;        // occurrences of the exact line in the baseline
+    unsigned divergeDepth;     // keys known before the line leaves the trie, length if it never does
+    double branchEntropy;      // local entropy of the prefix where the line leaves the trie
+    unsigned length;
+    unsigned lengthFrequency;  // baseline words of the same length
+    uint8_t categories;        // AnomalyCategory flags against the baseline thresholds
+};
+
+
+/**
+ * @brief Scores new lines against a frozen baseline trie.
+ * A line is walked once from the root (StatTrie::match); its score is then compared with the
+ * thresholds of the baseline Analysis. The entropy flag is only raised for lines that are not
+ * baseline words: it marks lines leaving the trie at a high-entropy branch point.
+ * Counts are read from the trie at scoring time, thresholds are fixed at construction: the trie may
+ * grow between calls (stream mode) but not during one; scoring itself is const and thread-safe.
+ */
+class Scorer {
+
+    private:
+
+    const StatTrie* trie;
+    double freqThreshold;
+    double lenFreqThreshold;
+    double entropyThreshold;
+    std::vector<unsigned> lenFreq; // baseline length histogram indexed by length
+
+
+    public:
+
+    Scorer(const StatTrie &trie, const Analysis &analysis);
+
+    LineScore score(std::string_view line) const;
+    void score(const std::vector<std::string_view> &lines, std::vector<LineScore> &scores) const;
+    // Score every '\n'-separated line of buffer, in order
+    void scoreBuffer(std::string_view buffer, std::vector<LineScore> &scores) const;
+};
+
+
+#endif
@@ -13,12 +13,17 @@
 #include <iomanip>
 #include <cmath>
 #include "nlohmann/json.hpp"
+#include "SymbolTable.h"
+#include "ArrayHash.h"
 
 
 
 struct Node {
-    std::unordered_map<char, Node*> children;
+    std::unordered_map<Symbol, Node*> children; // key: byte value, or token id in token mode
+    ArrayHash* bucket; // burst-trie container holding every suffix below this node (no children then)
     unsigned count;
+    unsigned endCount;  // number of inserted words ending exactly here
+    double entropySum;  // sum of c*log2(c) over children counts and endCount, kept up to date by insert/remove
     bool isEnd;
 
     Node();
@@ -26,19 +31,100 @@ struct Node {
     unsigned countEnd() const;
 };
 
+
+/**
+ * @brief Block allocator for trie nodes.
+ * Nodes live in fixed-size arrays; removed nodes go to a free list and are reused.
+ */
+class NodePool {
+
+    private:
+
+    std::vector<Node*> blocks;    // each block holds BLOCK_SIZE nodes
+    size_t used;                  // nodes handed out from the last block
+    std::vector<Node*> freeList;
+
+    public:
+
+    static constexpr size_t BLOCK_SIZE = 4096;
+
+    NodePool();
+    ~NodePool();
+    NodePool (const NodePool&) = delete;
+    NodePool& operator= (const NodePool&) = delete;
+
+    Node* acquire();
+    void release (Node* node);
+    void clear();
+    void swap (NodePool &other);
+
+    size_t totalBlocks() const;
+    size_t totalFreeSlots() const;
+};
+
+
+// Memory layout of the nodes, as seen by a preorder (DFS) walk
+struct LayoutStatistics {
+    unsigned nodes;
+    size_t blocks;          // pool blocks in use
+    size_t freeSlots;       // slots freed by remove and not reused yet
+    double sequentialRate;  // share of DFS steps landing on the very next slot
+    double meanJump;        // mean distance in bytes between consecutive DFS nodes
+};
+
+// How far a word follows the trie, see StatTrie::match
+struct WordMatch {
+    unsigned length;    // keys in the word
+    unsigned depth;     // keys matched from the root, length if the whole word is a known prefix
+    unsigned count;     // words through the deepest matched prefix
+    unsigned endCount;  // occurrences of the word itself, 0 unless depth == length
+    double entropy;     // local entropy of the deepest matched prefix (the branch point)
+};
+
+// A node and the prefix that spells it, as passed to traverse callbacks
+struct Subtree {
+    const Node* node;
+    std::string prefix;
+};
+
 class StatTrie {
     
     private:
 
+    NodePool pool;
     Node* root;
     unsigned countNodes; // Total number of Nodes currently in Trie
     unsigned countUniqueWordChar;
     unsigned countUniqueWords;   // Total number of unique words currently stored in Trie
     unsigned countInsertedWords; // Total number of words inserted to Trie (including duplications)
+    SymbolTable* symbols;        // nullptr: keys are characters; otherwise keys are interned tokens
+    unsigned burstThreshold;     // 0: plain trie; otherwise max suffixes per container before it bursts
+    unsigned countContainers;
+    unsigned countContainerEntries;
+    std::vector<Symbol> keyBuffer; // token ids of the word being inserted or removed
+
+    template <typename Keys> void _insert (const Keys& keys, unsigned num);
+    template <typename Keys> bool _contains (const Keys& keys) const;
+    template <typename Keys> bool _startWith (const Keys& keys) const;
+    template <typename Keys> void _remove (const Keys& keys);
+    bool splitTokens (std::string_view word, std::vector<Symbol> &keys, bool intern) const;
+    void appendKey (std::string &prefix, Symbol key) const;
+    std::string keyLabel (Symbol key) const;
+
+    void insertIntoContainer (Node* owner, std::string_view suffix, unsigned num, size_t wordLength);
+    void burst (Node* node);
+    void deleteNode (Node* node);
 
     void _clear (Node* node);
+    void _recomputeEntropySums (Node* node);
+    Node* relocate (const Node* node, NodePool &target);
     void _traverse (std::function<void(const Node*, const std::string&)> &callback, const Node* currNode, std::string &prefix) const;
-    
+    void _traverseRange (std::function<void(const Node*, const std::string&)> &callback, const Node* owner,
+                         const std::vector<std::pair<std::string_view, unsigned>> &entries,
+                         size_t lo, size_t hi, size_t depth, std::string &prefix) const;
+    nlohmann::json containerJSON (const std::vector<std::pair<std::string_view, unsigned>> &entries,
+                                  size_t lo, size_t hi, size_t depth, bool trim, unsigned &id) const;
+
     nlohmann::json toPartialJSON(const Node* root, const std::unordered_set<const Node*> &trimNodes, bool &containTrimNode, unsigned &id) const;
     nlohmann::json toJSON(const Node* root, const std::unordered_set<const Node*> &anomalyNodes, unsigned &id) const;
 
@@ -48,20 +134,60 @@ class StatTrie {
     StatTrie();
     ~StatTrie();
     
-    void insert (std::string word);
-    void insert (std::string word, unsigned num);
-    bool contains (std::string word) const;
-    bool startWith (std::string prefix) const;
-    void remove (std::string word);
+    // Words are only read during the call, so views into a mapped file can be inserted directly
+    void insert (std::string_view word);
+    void insert (std::string_view word, unsigned num);
+    void insert (const std::vector<Symbol> &word);
+    void insert (const std::vector<Symbol> &word, unsigned num);
+    bool contains (std::string_view word) const;
+    bool startWith (std::string_view prefix) const;
+    void remove (std::string_view word);
     void clear();
 
+    // Rewrite node storage in DFS order so traversals stream through memory
+    // (invalidates every Node pointer obtained before the call); recomputes the entropy sums as below
+    void compact();
+    // Rebuild every entropySum from the counts, in a fixed order: equal tries then hold identical
+    // sums whatever the insertion order and rounding of their updates (a restored checkpoint,
+    // --counts ingest). One pass over the nodes
+    void recomputeEntropySums();
+    LayoutStatistics layoutStatistics() const;
+
+    // Token mode: keys are ids interned in table, prefixes are rendered as space-separated tokens.
+    // Must be set while the trie is empty.
+    void setSymbolTable (SymbolTable* table);
+    SymbolTable* symbolTable() const;
+    unsigned depthOf (const std::string &prefix) const;
+
+    // Burst-trie mode (character keys only): new sparse subtrees are kept as array-hash containers
+    // of suffixes that burst into real nodes once they hold more than threshold suffixes.
+    // Must be set while the trie is empty.
+    void setBurstThreshold (unsigned threshold);
+    unsigned containerThreshold() const;
+    unsigned totalContainers() const;
+    unsigned totalContainerEntries() const;
+
     unsigned totalNodes() const;
     unsigned totalUniqueWordCharacters() const;
     unsigned totalInsertedWords() const;
     unsigned totalUniqueWords() const;
 
+    // Prefixes stored inside containers are passed as temporary view nodes (count, isEnd and
+    // one level of children counts) that are only valid during the callback
     void traverse (std::function<void(const Node*, const std::string&)> callback) const;
     void traverse (const std::string prefix, std::function<void(const Node*, const std::string&)> callback) const;
+    const Node* locate (const std::string &prefix) const;
+    // Follow a word (space-separated tokens in token mode) from the root as far as it is known,
+    // without allocating; read-only, so any number of threads may match concurrently
+    WordMatch match (std::string_view word) const;
+
+    // Cut the trie into disjoint subtrees for parallel traversal: starting from the root, the
+    // subtree with the largest count is split (its root goes to heads, its children become
+    // subtrees) until every subtree counts at most maxCount or maxSubtrees is reached.
+    // Containers are never split. The result depends only on the trie, subtrees come sorted by prefix.
+    void partition (unsigned maxCount, size_t maxSubtrees, std::vector<Subtree> &heads, std::vector<Subtree> &subtrees) const;
+    // Visit a subtree from partition() like traverse() visits the whole trie
+    void traverse (const Subtree &subtree, std::function<void(const Node*, const std::string&)> callback) const;
 
     void exportPartialJSON(const std::string exportFile, const std::unordered_set<const Node*> &trimNodes) const;
     void exportAllJSON(const std::string exportFile, const std::unordered_set<const Node*> &anomalyNodes) const;
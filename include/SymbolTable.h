@@ -0,0 +1,52 @@
+#ifndef _SYMBOLTABLE_
+#define _SYMBOLTABLE_
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+typedef uint32_t Symbol;
+
+
+/**
+ * @brief Compact string-interning dictionary.
+ * Every distinct token is stored once, back to back, in a single character pool
+ * and is addressed by a dense 32-bit id (0, 1, 2, ...) in order of first appearance.
+ * Lookup by content goes through an open-addressing index holding only ids.
+ */
+class SymbolTable {
+
+    private:
+
+    std::string pool;               // all interned tokens, concatenated
+    std::vector<uint32_t> offsets;  // token i occupies pool[offsets[i], offsets[i+1])
+    std::vector<Symbol> slots;      // open-addressing index, npos = empty slot
+
+    static uint64_t hash (std::string_view token);
+    size_t findSlot (std::string_view token) const;
+    void grow();
+
+
+    public:
+
+    static constexpr Symbol npos = UINT32_MAX;
+
+    SymbolTable();
+
+    Symbol intern (std::string_view token);
+    Symbol find (std::string_view token) const;
+    std::string_view lookup (Symbol id) const;
+
+    size_t size() const;
+    size_t memoryUsage() const;
+    void clear();
+
+    // Next token of line from i on (tokens are separated by spaces and tabs), advancing i past
+    // it; empty at the end of line
+    static std::string_view nextToken (std::string_view line, size_t &i);
+};
+
+
+#endif
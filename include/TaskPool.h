@@ -0,0 +1,34 @@
+#ifndef _TASKPOOL_
+#define _TASKPOOL_
+
+#include <cstddef>
+#include <functional>
+
+
+/**
+ * @brief Runs a batch of independent tasks on worker threads with work stealing.
+ * Tasks are dealt round-robin into one deque per worker; a worker takes from the back of
+ * its own deque and, once it is empty, steals from the front of the others, so one long
+ * task does not leave the rest of the batch waiting behind it.
+ */
+class TaskPool {
+
+    private:
+
+    unsigned countThreads;
+
+
+    public:
+
+    TaskPool (unsigned threads = 0); // 0: one per hardware thread
+
+    unsigned size() const;
+
+    // Call task(i, worker) for every i in [0, n) and wait for all of them; worker is in [0, size())
+    void run (size_t n, const std::function<void(size_t, unsigned)> &task) const;
+    // Split [0, n) into contiguous chunks and call chunk(begin, end) for each one
+    void forChunks (size_t n, const std::function<void(size_t, size_t)> &chunk) const;
+};
+
+
+#endif
@@ -0,0 +1,88 @@
+#ifndef _TEMPLATEMINER_
+#define _TEMPLATEMINER_
+
+#include "SymbolTable.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+
+// Token classes TemplateMiner masks before clustering, as flags
+enum TokenClass : uint8_t {
+    MASK_NUMBER = 1,   // 42, -7, 3.14                                   -> <num>
+    MASK_HEX    = 2,   // 0x1f, 9f86d081a3 (8+ hex digits, some letters) -> <hex>
+    MASK_IP     = 4,   // 10.0.0.1, 10.0.0.1:8080, fe80::1               -> <ip>
+    MASK_TIME   = 8,   // 2024-01-31, 12:00:05.123, 2024-01-31t12:00:05z -> <time>
+    MASK_UUID   = 16,  // 123e4567-e89b-12d3-a456-426614174000           -> <uuid>
+    MASK_ALL    = 31
+};
+
+
+/**
+ * @brief Drain-style online log template miner over cleaned lines.
+ * A line is split on spaces and every token of an enabled class (possibly inside brackets,
+ * quotes or after "key=") is replaced by the class placeholder. The masked tokens then go down
+ * a fixed-depth tree keyed by token count and the first tokens to a short list of clusters,
+ * and join the most similar one (share of positions with equal tokens) if it reaches the
+ * similarity threshold: positions where they differ become the wildcard <*>. Otherwise they
+ * start a new cluster. Tokens are interned, so templates compare ids.
+ */
+class TemplateMiner {
+
+    private:
+
+    struct Branch {
+        std::unordered_map<Symbol, std::unique_ptr<Branch>> children;
+        std::vector<uint32_t> clusters;   // at the leaves
+    };
+
+    SymbolTable symbols;                  // tokens of the templates, the wildcard first
+    std::vector<std::vector<Symbol>> templates;
+    std::vector<size_t> sizes;            // lines per template
+    std::unordered_map<size_t, Branch> byLength;
+    uint8_t masks;
+    double threshold;
+    Symbol wildcard;
+
+    // scratch of the last masked line
+    std::string masked;
+    std::vector<std::string_view> tokens;     // into masked
+    std::vector<std::string_view> originals;  // the same tokens in the line
+    std::vector<std::string_view> variables;  // masked part of each original token, empty if none
+    std::vector<size_t> bounds;               // token offsets in masked
+    std::vector<Symbol> ids;
+
+    static constexpr size_t TREE_DEPTH = 2;     // tokens routing a line below its length
+    static constexpr size_t MAX_CHILDREN = 100; // further tokens of a branch go under <*>
+
+    void mask (std::string_view line);
+    Branch* route (Branch &root, bool create);
+
+
+    public:
+
+    // similarity: share of equal tokens needed to join a template (Drain's st, default 0.5)
+    TemplateMiner (uint8_t masks = MASK_ALL, double similarity = 0.5);
+
+    // Masked line only, as it is clustered
+    std::string maskLine (std::string_view line);
+    // Cluster one cleaned line; the id of its template (0, 1, 2, ... in order of creation)
+    uint32_t add (std::string_view line);
+    // Values of line (added earlier as template id) at the variable positions of the template:
+    // the masked parts, and whole tokens under <*>; views into line
+    void parameters (std::string_view line, uint32_t id, std::vector<std::string_view> &values);
+
+    size_t size() const;
+    std::string templateOf (uint32_t id) const;
+    size_t templateSize (uint32_t id) const; // lines that joined it
+
+    // Comma-separated class names (num, hex, ip, time, uuid, all, none) into masks; false on an unknown one
+    static bool parseMasks (const std::string &names, uint8_t &masks);
+};
+
+
+#endif
@@ -1,40 +1,139 @@
 #include "Analysis.h"
+#include "Entropy.h"
+#include <climits>
+#include <cstring>
+#include <mutex>
+#include <numeric>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 using namespace std;
 using json = nlohmann::json;
 
 
+/* ==================== Entry table ==================== */
+
+size_t EntryTable::size() const {
+    return counts.size();
+}
+
+string_view EntryTable::word(size_t i) const {
+    return string_view(wordPool.data() + wordOffsets[i], wordLengths[i]);
+}
+
+void EntryTable::clear() {
+    counts.clear();
+    depths.clear();
+    lenFreqs.clear();
+    entropies.clear();
+    freqRates.clear();
+    isWord.clear();
+    nodeIds.clear();
+    categories.clear();
+    wordOffsets.clear();
+    wordLengths.clear();
+    wordPool.clear();
+    mapping.reset();
+}
+
+void EntryTable::resize(size_t n) {
+    counts.resize(n);
+    depths.resize(n);
+    lenFreqs.resize(n);
+    entropies.resize(n);
+    freqRates.resize(n);
+    isWord.resize(n);
+    nodeIds.resize(n);
+    categories.resize(n);
+    wordOffsets.resize(n);
+    wordLengths.resize(n);
+}
+
+template <typename T>
+static void gather(Column<T> &column, const vector<uint32_t> &order) {
+    vector<T> out(order.size());
+    for (size_t i = 0; i < order.size(); ++i) out[i] = column[order[i]];
+    column = Column<T>(move(out));
+}
+
+// The word pool itself is left in place, only the offsets move; one column per task
+void EntryTable::permute(const vector<uint32_t> &order, const TaskPool &pool) {
+    pool.run(10, [&](size_t column, unsigned) {
+        switch (column) {
+            case 0: gather(counts, order); break;
+            case 1: gather(depths, order); break;
+            case 2: gather(lenFreqs, order); break;
+            case 3: gather(entropies, order); break;
+            case 4: gather(freqRates, order); break;
+            case 5: gather(isWord, order); break;
+            case 6: gather(nodeIds, order); break;
+            case 7: gather(categories, order); break;
+            case 8: gather(wordOffsets, order); break;
+            case 9: gather(wordLengths, order); break;
+        }
+    });
+}
+
+
 /* ==================== Constructor ==================== */
 
 Analysis::Analysis(double freqPercentile, double lenPercentile, double entropyPercentile) : 
     // trie(trie),
+    trie(nullptr),
     freqPercentile(freqPercentile), entropyPercentile(entropyPercentile), lenPercentile(lenPercentile),
     freqThreshold(0), entropyThreshold(0), lenFreqThreshold(0),
-    totalInsertedWords(0), totalUniqueWords(0), totalNodes(0), totalUniqueWordChar(0),
+    totalInsertedWords(0), totalUniqueWords(0), totalNodes(0), totalUniqueWordChar(0), totalSymbols(0),
+    totalContainers(0), totalContainerEntries(0), burstThreshold(0), tokenMode(false),
     maxFreq(0), minFreq(0),
     maxDepth(0), minDepth(0),
     maxEntropy(0), minEntropy(0),
-    freqAnomaliesRate(0), lenAnomaliesRate(0), entropyAnomaliesRate(0) {}
+    freqAnomaliesRate(0), lenAnomaliesRate(0), entropyAnomaliesRate(0),
+    totalFreqAnomalies(0), totalLenAnomalies(0), totalEntropyAnomalies(0), topK(0) {}
 
     
 /* ==================== Helper: Compute entropy ==================== */
 
-double Analysis::computeLocalEntropy(const Node* node) {
-    double total = node->count;
+// H = log2(N) - (1/N) * sum(c*log2(c)), the sum being maintained by the trie on every update
+double Analysis::computeLocalEntropy(const Node* node) const {
+    // a single outcome has no entropy; checked explicitly so rounding in the sum cannot leak in
+    size_t outcomes = node->children.size() + (node->endCount > 0);
+    if (outcomes < 2) return 0;
+    return entropy::localEntropy(node->count, node->entropySum);
+}
 
-    double H = 0.0;
-    for (auto &p : node->children) {
-        double p_i = p.second->count / total;
-        H -= p_i * log2(p_i);
-    }
-    double p_end = node->countEnd() / total;
-    if (node->isEnd) H -= p_end * log2(p_end);
 
-    return H;
+/* ==================== Traverse Trie and collect statistics ==================== */
+
+namespace {
+
+    // What one traversal task collects; tasks are merged in task order
+    struct TaskStatistics {
+        EntryTable entries;
+        unordered_map<unsigned, unsigned> lenFreq;
+        QuantileSketch freqSketch;
+        QuantileSketch entropySketch;
+        uint32_t nodes = 0;     // nodes visited so far: the local id of the next one
+    };
+
+    // Extremum of a range of entries
+    struct Extremum {
+        unsigned maxFreq = 0, minFreq = UINT_MAX;
+        unsigned maxDepth = 0, minDepth = UINT_MAX;
+        double maxEntropy = 0, minEntropy = HUGE_VAL;
+    };
 }
 
+void Analysis::setThreads(unsigned threads) {
+    pool = TaskPool(threads);
+}
 
-/* ==================== Traverse Trie and collect statistics ==================== */
+void Analysis::setTopK(size_t k) {
+    topK = k;
+}
 
+// The trie is cut into subtrees of bounded count (StatTrie::partition) that are traversed as
+// independent tasks; the cut depends only on the trie, so results are the same for any number of threads
 void Analysis::collectStatistics(const StatTrie* _trie) {
 
     trie = _trie;
@@ -42,111 +141,286 @@ void Analysis::collectStatistics(const StatTrie* _trie) {
     totalUniqueWords = trie->totalUniqueWords();
     totalNodes = trie->totalNodes();
     totalUniqueWordChar = trie->totalUniqueWordCharacters();
+    totalSymbols = trie->symbolTable() ? trie->symbolTable()->size() : 0;
+    totalContainers = trie->totalContainers();
+    totalContainerEntries = trie->totalContainerEntries();
+    burstThreshold = trie->containerThreshold();
+    tokenMode = trie->symbolTable() != nullptr;
+
+    entries.clear();
+    rankedFreq.clear();
+    rankedLen.clear();
+    rankedEntropy.clear();
+    lenFreq.clear();
+    freqSketch.clear();
+    entropySketch.clear();
+
+    vector<Subtree> heads, subtrees;
+    trie->partition(max(1u, totalInsertedWords / TASK_GRAIN), 4 * TASK_GRAIN, heads, subtrees);
+
+    // task 0 visits the split nodes themselves, task t > 0 traverses subtrees[t-1]
+    vector<TaskStatistics> tasks(subtrees.size() + 1);
+    for (TaskStatistics &t : tasks) {
+        t.freqSketch = freqSketch;
+        t.entropySketch = entropySketch;
+    }
 
-    allEntries.clear();
-    
-    auto callback = [&](const Node* node, const std::string &word){
-        double localEntropy = computeLocalEntropy(node);
-        if (localEntropy > 0) {
-            AnomalyEntry entry;
-            entry.isWord = false;
-            entry.word = word;
-            entry.count = node->count;
-            entry.freqRate = (double)entry.count / totalInsertedWords;
-            entry.depth = word.size();
-            entry.entropy = localEntropy;
-
-            allEntries.push_back(entry);
-        }
-        if (node->isEnd) {
-            AnomalyEntry entry;
-            entry.isWord = true;
-            entry.word = word;
-            entry.count = node->countEnd();
-            entry.freqRate = (double)entry.count / totalInsertedWords;
-            entry.depth = word.size();
-            entry.entropy = localEntropy;
+    pool.run(tasks.size(), [&](size_t t, unsigned) {
+        TaskStatistics &stats = tasks[t];
+        EntryTable &table = stats.entries;
+
+        auto push = [&](unsigned count, size_t wordOffset, size_t wordLength, unsigned depth, double localEntropy, bool word) {
+            table.counts.push_back(count);
+            table.depths.push_back(depth);
+            table.lenFreqs.push_back(0);
+            table.entropies.push_back(localEntropy);
+            table.freqRates.push_back((double)count / totalInsertedWords);
+            table.isWord.push_back(word);
+            table.nodeIds.push_back(stats.nodes);
+            table.categories.push_back(0);
+            table.wordOffsets.push_back(wordOffset);
+            table.wordLengths.push_back(wordLength);
+        };
+
+        auto callback = [&](const Node* node, const std::string &word){
+            double localEntropy = computeLocalEntropy(node);
+            if (localEntropy > 0 || node->isEnd) {
+                size_t wordOffset = table.wordPool.size();
+                unsigned depth = trie->depthOf(word);
+                table.wordPool.append(word.data(), word.size());
+
+                if (localEntropy > 0) {
+                    push(node->count, wordOffset, word.size(), depth, localEntropy, false);
+                    stats.entropySketch.add(localEntropy);
+                }
+                if (node->isEnd) {
+                    push(node->countEnd(), wordOffset, word.size(), depth, localEntropy, true);
+                    stats.freqSketch.add(node->countEnd());
+                    stats.lenFreq[depth] += node->countEnd();
+                }
+            }
+            ++stats.nodes;
+        };
 
-            allEntries.push_back(entry);
+        if (t == 0) for (const Subtree &head : heads) callback(head.node, head.prefix);
+        else trie->traverse(subtrees[t - 1], callback);
+    });
 
-            if (lenFreq.count(entry.depth)) lenFreq[entry.depth] += entry.count;
-            else lenFreq[entry.depth] = entry.count;
+    // node ids are preorder ranks: the split nodes and the subtrees below them, in prefix order,
+    // are the top of a preorder walk, in which every subtree takes as many ids as it has nodes.
+    // Task 0's local id is the index of its split node, task t's the rank inside subtrees[t-1].
+    // In token mode the separator sorts first, so a prefix comes right before its extensions.
+    vector<uint32_t> headIds(heads.size()), subtreeBase(subtrees.size());
+    vector<pair<const string*, size_t>> walk;  // prefix, then h for heads[h] or heads.size() + s for subtrees[s]
+    for (size_t h = 0; h < heads.size(); ++h) walk.emplace_back(&heads[h].prefix, h);
+    for (size_t s = 0; s < subtrees.size(); ++s) walk.emplace_back(&subtrees[s].prefix, heads.size() + s);
+    auto rank = [&](unsigned char c) { return tokenMode && c == ' ' ? 0 : c + 1; };
+    sort(walk.begin(), walk.end(), [&](const pair<const string*, size_t> &a, const pair<const string*, size_t> &b) {
+        return lexicographical_compare(a.first->begin(), a.first->end(), b.first->begin(), b.first->end(),
+                                       [&](unsigned char x, unsigned char y) { return rank(x) < rank(y); });
+    });
+    uint32_t nextId = 0;
+    for (const pair<const string*, size_t> &w : walk) {
+        if (w.second < heads.size()) headIds[w.second] = nextId++;
+        else {
+            size_t s = w.second - heads.size();
+            subtreeBase[s] = nextId;
+            nextId += tasks[s + 1].nodes;
+        }
+    }
 
-            // totalUniqueWordChar += entry.depth;
+    // concatenate task tables in task order
+    vector<size_t> entryBase(tasks.size() + 1, 0), poolBase(tasks.size() + 1, 0);
+    for (size_t t = 0; t < tasks.size(); ++t) {
+        entryBase[t + 1] = entryBase[t] + tasks[t].entries.size();
+        poolBase[t + 1] = poolBase[t] + tasks[t].entries.wordPool.size();
+
+        for (pair<const unsigned, unsigned> &p : tasks[t].lenFreq) lenFreq[p.first] += p.second;
+        freqSketch.merge(tasks[t].freqSketch);
+        entropySketch.merge(tasks[t].entropySketch);
+    }
+    entries.resize(entryBase.back());
+    entries.wordPool.resize(poolBase.back());
+
+    pool.run(tasks.size(), [&](size_t t, unsigned) {
+        const EntryTable &table = tasks[t].entries;
+        size_t base = entryBase[t];
+        copy(table.counts.begin(), table.counts.end(), entries.counts.begin() + base);
+        copy(table.depths.begin(), table.depths.end(), entries.depths.begin() + base);
+        copy(table.entropies.begin(), table.entropies.end(), entries.entropies.begin() + base);
+        copy(table.freqRates.begin(), table.freqRates.end(), entries.freqRates.begin() + base);
+        copy(table.isWord.begin(), table.isWord.end(), entries.isWord.begin() + base);
+        copy(table.wordLengths.begin(), table.wordLengths.end(), entries.wordLengths.begin() + base);
+        copy(table.wordPool.begin(), table.wordPool.end(), entries.wordPool.begin() + poolBase[t]);
+        for (size_t i = 0; i < table.size(); ++i) {
+            entries.nodeIds[base + i] = t == 0 ? headIds[table.nodeIds[i]] : subtreeBase[t - 1] + table.nodeIds[i];
+            entries.wordOffsets[base + i] = poolBase[t] + table.wordOffsets[i];
+            entries.lenFreqs[base + i] = table.isWord[i] ? lenFreq.at(table.depths[i]) : 0;
         }
-    };
-    trie->traverse(callback);
+        tasks[t] = TaskStatistics();
+    });
 
-    sort(allEntries.begin(), allEntries.end(), [](AnomalyEntry& a, AnomalyEntry& b) {
-        if (a.word.compare(b.word) == 0) return !a.isWord && b.isWord;
-        return a.word.compare(b.word) < 0;
+    // sort by word, a prefix entry before the word entry of the same node:
+    // every task range is sorted on its own, then ranges are merged pairwise
+    auto before = [&](uint32_t a, uint32_t b) {
+        int cmp = entries.word(a).compare(entries.word(b));
+        if (cmp == 0) return entries.isWord[a] < entries.isWord[b];
+        return cmp < 0;
+    };
+    vector<uint32_t> order(entries.size()), merged(entries.size());
+    iota(order.begin(), order.end(), 0);
+    pool.run(tasks.size(), [&](size_t t, unsigned) {
+        sort(order.begin() + entryBase[t], order.begin() + entryBase[t + 1], before);
     });
+    for (size_t width = 1; width < tasks.size(); width *= 2) {
+        size_t pairs = (tasks.size() + 2 * width - 1) / (2 * width);
+        pool.run(pairs, [&](size_t p, unsigned) {
+            size_t lo = entryBase[min(tasks.size(), 2 * p * width)];
+            size_t mid = entryBase[min(tasks.size(), (2 * p + 1) * width)];
+            size_t hi = entryBase[min(tasks.size(), (2 * p + 2) * width)];
+            merge(order.begin() + lo, order.begin() + mid, order.begin() + mid, order.begin() + hi, merged.begin() + lo, before);
+        });
+        order.swap(merged);
+    }
+    entries.permute(order, pool);
+
+    // the task sketches are merged in task order: exact up to the limit, but past it the merged
+    // sketch depends on how the trie was split. It is then refilled in entry (word) order, like a
+    // single sketch over a serial pass in that order, and like load() refills it
+    if (!freqSketch.isExact() || !entropySketch.isExact()) refillSketches();
 
     getExtremum();
     computePercentileThresholds();
     detectAnomalies();
 }
 
-void Analysis::getExtremum() {
+// Same traversal as collectStatistics, but only the histogram and the sketches are filled:
+// no entry table, no sort, no classification. Without entries to refill them from, the task
+// sketches stay merged in task order: past the exact limit the thresholds are KLL estimates
+// that can differ slightly from collectStatistics' (within the sketch's rank error)
+void Analysis::refreshThresholds(const StatTrie* _trie) {
 
-    for (AnomalyEntry &e : allEntries) {
-        if (e.isWord) {
-            if (e.count > maxFreq) maxFreq = e.count;
-            if (e.depth > maxDepth) maxDepth = e.depth;
-        }
-        if (e.entropy > maxEntropy) maxEntropy = e.entropy;
+    trie = _trie;
+    totalInsertedWords = trie->totalInsertedWords();
+    lenFreq.clear();
+    freqSketch.clear();
+    entropySketch.clear();
+
+    vector<Subtree> heads, subtrees;
+    trie->partition(max(1u, totalInsertedWords / TASK_GRAIN), 4 * TASK_GRAIN, heads, subtrees);
+
+    vector<TaskStatistics> tasks(subtrees.size() + 1);
+    for (TaskStatistics &t : tasks) {
+        t.freqSketch = freqSketch;
+        t.entropySketch = entropySketch;
     }
 
-    minFreq = maxFreq;
-    minDepth = maxDepth;
-    minEntropy = maxEntropy;
-    for (AnomalyEntry &e : allEntries) {    
-        if (e.isWord) {
-            if (e.count < minFreq) minFreq = e.count;
-            if (e.depth < minDepth) minDepth = e.depth;
-        }
-        if (e.entropy < minEntropy) minEntropy = e.entropy;
+    pool.run(tasks.size(), [&](size_t t, unsigned) {
+        TaskStatistics &stats = tasks[t];
+        auto callback = [&](const Node* node, const std::string &word){
+            double localEntropy = computeLocalEntropy(node);
+            if (localEntropy > 0) stats.entropySketch.add(localEntropy);
+            if (node->isEnd) {
+                stats.freqSketch.add(node->countEnd());
+                stats.lenFreq[trie->depthOf(word)] += node->countEnd();
+            }
+        };
+        if (t == 0) for (const Subtree &head : heads) callback(head.node, head.prefix);
+        else trie->traverse(subtrees[t - 1], callback);
+    });
+
+    for (TaskStatistics &t : tasks) {
+        for (pair<const unsigned, unsigned> &p : t.lenFreq) lenFreq[p.first] += p.second;
+        freqSketch.merge(t.freqSketch);
+        entropySketch.merge(t.entropySketch);
     }
+    computePercentileThresholds();
 }
 
+void Analysis::refillSketches() {
+    freqSketch.clear();
+    entropySketch.clear();
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (entries.isWord[i]) freqSketch.add(entries.counts[i]);
+        else entropySketch.add(entries.entropies[i]);
+    }
+}
 
-void Analysis::computePercentileThresholds() {
+void Analysis::getExtremum() {
 
-    std::vector<unsigned> freqs;
-    std::vector<double> entropies;
-    std::vector<pair<unsigned, unsigned>> lenFreqs;
+    const unsigned* counts = entries.counts.data();
+    const unsigned* depths = entries.depths.data();
+    const double* entropies = entries.entropies.data();
+    const uint8_t* isWord = entries.isWord.data();
+
+    // extremum per chunk, combined afterwards
+    vector<Extremum> chunks;
+    mutex lock;
+    pool.forChunks(entries.size(), [&](size_t begin, size_t end) {
+        Extremum e;
+        for (size_t i = begin; i < end; ++i) {
+            if (isWord[i]) {
+                e.maxFreq = max(e.maxFreq, counts[i]);
+                e.minFreq = min(e.minFreq, counts[i]);
+                e.maxDepth = max(e.maxDepth, depths[i]);
+                e.minDepth = min(e.minDepth, depths[i]);
+            }
+            e.maxEntropy = max(e.maxEntropy, entropies[i]);
+            e.minEntropy = min(e.minEntropy, entropies[i]);
+        }
+        lock_guard<mutex> guard(lock);
+        chunks.push_back(e);
+    });
 
-    for (pair<const unsigned, unsigned> &p : lenFreq) 
-        lenFreqs.push_back(pair<unsigned, unsigned> (p.first, p.second));
-    
-    for (auto &e : allEntries) {
-        if (e.isWord) freqs.push_back(e.count);
-        if (!e.isWord) entropies.push_back(e.entropy);
+    Extremum all;
+    for (const Extremum &e : chunks) {
+        all.maxFreq = max(all.maxFreq, e.maxFreq);
+        all.minFreq = min(all.minFreq, e.minFreq);
+        all.maxDepth = max(all.maxDepth, e.maxDepth);
+        all.minDepth = min(all.minDepth, e.minDepth);
+        all.maxEntropy = max(all.maxEntropy, e.maxEntropy);
+        all.minEntropy = min(all.minEntropy, e.minEntropy);
     }
 
-    std::sort(freqs.begin(), freqs.end());
-    std::sort(entropies.begin(), entropies.end());
-    std::sort(lenFreqs.begin(), lenFreqs.end(), [] (pair<unsigned, unsigned> &a, pair<unsigned, unsigned> &b) {
-        return a.second < b.second;
-    });
+    // without any word (or entry), the minimum falls back to the maximum
+    maxFreq = all.maxFreq;
+    maxDepth = all.maxDepth;
+    maxEntropy = all.maxEntropy;
+    minFreq = min(all.minFreq, maxFreq);
+    minDepth = min(all.minDepth, maxDepth);
+    minEntropy = min(all.minEntropy, maxEntropy);
+}
+
+
+void Analysis::setQuantileExactLimit(size_t limit) {
+    freqSketch = QuantileSketch(limit);
+    entropySketch = QuantileSketch(limit);
+}
+
+
+// Frequency and entropy percentiles come from the sketches filled during the traversal;
+// there is one length-frequency value per distinct length, so that one is selected directly
+void Analysis::computePercentileThresholds() {
 
-    size_t fIdx = (size_t)((freqPercentile/100.0) * freqs.size());
-    size_t eIdx = (size_t)((entropyPercentile/100.0) * entropies.size());
-    size_t lIdx = (size_t)((lenPercentile/100.0) * lenFreqs.size());
+    if (freqSketch.size()) freqThreshold = freqSketch.quantile(freqPercentile);
+    if (entropySketch.size()) entropyThreshold = entropySketch.quantile(entropyPercentile);
 
-    if (fIdx >= freqs.size()) fIdx = freqs.size() - 1;
-    if (eIdx >= entropies.size()) eIdx = entropies.size() - 1;
-    if (lIdx >= lenFreqs.size()) lIdx = lenFreqs.size() - 1;
+    std::vector<unsigned> lenFreqs;
+    lenFreqs.reserve(lenFreq.size());
+    for (pair<const unsigned, unsigned> &p : lenFreq) lenFreqs.push_back(p.second);
 
-    if(!freqs.empty()) freqThreshold = freqs[fIdx];
-    if(!entropies.empty()) entropyThreshold = entropies[eIdx];
-    if(!lenFreqs.empty()) lenFreqThreshold = lenFreqs[lIdx].second;
+    if (!lenFreqs.empty()) {
+        size_t lIdx = (size_t)((lenPercentile/100.0) * lenFreqs.size());
+        if (lIdx >= lenFreqs.size()) lIdx = lenFreqs.size() - 1;
+        nth_element(lenFreqs.begin(), lenFreqs.begin() + lIdx, lenFreqs.end());
+        lenFreqThreshold = lenFreqs[lIdx];
+    }
 }
 
 
 void Analysis::markAnomalyNodes(unordered_set<const Node*> &anomalyNodes, const char mode) const {
     
-    const vector<AnomalyEntry>* anomalies = 0;
+    const vector<uint32_t>* anomalies = 0;
     if (mode == 'a') {
         markAnomalyNodes(anomalyNodes, 'f');
         markAnomalyNodes(anomalyNodes, 'l');
@@ -161,107 +435,406 @@ void Analysis::markAnomalyNodes(unordered_set<const Node*> &anomalyNodes, const
         return;
     }
     
-    string path;
-    auto callback = [&] (const Node* node, const string &prefix) {
-        if (prefix == path && node) anomalyNodes.insert(node);
-    };
+    if (!trie) {
+        cerr << "[ERROR] No trie attached to the analysis" << endl;
+        return;
+    }
 
-    for (const AnomalyEntry& e : *anomalies) {
-        path = e.word;
-        trie->traverse(path, callback);
+    // prefixes inside a burst container mark the container node
+    for (uint32_t i : *anomalies) {
+        const Node* node = trie->locate(string(entries.word(i)));
+        if (node) anomalyNodes.insert(node);
     }
 
 }
 
 
+double Analysis::frequencyThreshold() const {
+    return freqThreshold;
+}
+
+double Analysis::lengthFrequencyThreshold() const {
+    return lenFreqThreshold;
+}
+
+double Analysis::localEntropyThreshold() const {
+    return entropyThreshold;
+}
+
+const unordered_map<unsigned, unsigned>& Analysis::lengthFrequencies() const {
+    return lenFreq;
+}
+
+
 /* ==================== Detect anomalies by frequency/length/entropy ==================== */
 
 void Analysis::detectAnomalies() {
     
-    freqAnomalies.clear();
-    lenAnomalies.clear();
-    entropyAnomalies.clear();
-
-    for (auto &entry : allEntries) {
-        if (entry.isWord) {
-            if (entry.count <= freqThreshold) {
-                freqAnomalies.push_back(entry);
-                freqAnomalies.back().score = entry.count;
-                freqAnomaliesRate += entry.freqRate;
+    const unsigned* counts = entries.counts.data();
+    const unsigned* lenFreqs = entries.lenFreqs.data();
+    const double* entropies = entries.entropies.data();
+    const uint8_t* isWord = entries.isWord.data();
+    uint8_t* categories = entries.categories.data();
+    const double freqT = freqThreshold, lenT = lenFreqThreshold, entropyT = entropyThreshold;
+
+    // branch-free pass over the columns
+    pool.forChunks(entries.size(), [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            uint8_t word = isWord[i];
+            categories[i] = (uint8_t)((word & (counts[i] <= freqT)) * FREQ_ANOMALY
+                                    | (word & (lenFreqs[i] <= lenT)) * LEN_ANOMALY
+                                    | ((word ^ 1) & (entropies[i] >= entropyT)) * ENTROPY_ANOMALY);
+        }
+    });
+
+    // one task per metric: collect its entries in table order and sort them,
+    // theo score tăng dần (score càng nhỏ càng hiếm);
+    // in top-K mode only the K rarest are kept, in a bounded max-heap
+    auto byScore = [this](const unsigned* score) {
+        return [this, score](uint32_t a, uint32_t b) {
+            if (score[a] == score[b]) return entries.word(a).compare(entries.word(b)) < 0;
+            return score[a] < score[b];
+        };
+    };
+    // with a ranking from rankEntries() the anomalies of a metric are a prefix of it and need no sort
+    auto collect = [&](vector<uint32_t> &anomalies, double &rate, size_t &total, uint8_t category,
+                       const vector<uint32_t> &ranked, auto rarer) {
+        anomalies.clear();
+        rate = 0;
+        total = 0;
+        bool select = ranked.empty();
+        for (size_t i = 0; i < entries.size(); ++i) {
+            if (!(categories[i] & category)) continue;
+            ++total;
+            rate += entries.freqRates[i];
+            if (!select) continue;
+            if (!topK) anomalies.push_back(i);
+            else if (anomalies.size() < topK) {
+                anomalies.push_back(i);
+                push_heap(anomalies.begin(), anomalies.end(), rarer);
             }
-            if (lenFreq[entry.depth] <= lenFreqThreshold) {
-                lenAnomalies.push_back(entry);
-                lenAnomalies.back().score = lenFreq[entry.depth];
-                lenAnomaliesRate += entry.freqRate;
+            else if (rarer(i, anomalies.front())) {
+                pop_heap(anomalies.begin(), anomalies.end(), rarer);
+                anomalies.back() = i;
+                push_heap(anomalies.begin(), anomalies.end(), rarer);
             }
         }
-        else if (entry.entropy >= entropyThreshold) {
-            entropyAnomalies.push_back(entry);
-            entropyAnomalies.back().score = -entry.entropy;
-            entropyAnomaliesRate += entry.freqRate;
+        if (!select) anomalies.assign(ranked.begin(), ranked.begin() + (topK ? min(topK, total) : total));
+        else if (topK) sort_heap(anomalies.begin(), anomalies.end(), rarer);
+        else sort(anomalies.begin(), anomalies.end(), rarer);
+    };
+    pool.run(3, [&](size_t metric, unsigned) {
+        if (metric == 0) collect(freqAnomalies, freqAnomaliesRate, totalFreqAnomalies, FREQ_ANOMALY, rankedFreq, byScore(counts));
+        else if (metric == 1) collect(lenAnomalies, lenAnomaliesRate, totalLenAnomalies, LEN_ANOMALY, rankedLen, byScore(lenFreqs));
+        else {
+            // higher entropy is rarer; entropies are ranked to 1e-9, so that the rounding the running
+            // sums picked up from their update history cannot reorder equal entropies
+            collect(entropyAnomalies, entropyAnomaliesRate, totalEntropyAnomalies, ENTROPY_ANOMALY, rankedEntropy, [&](uint32_t a, uint32_t b) {
+                double ea = round(entropies[a] * 1e9), eb = round(entropies[b] * 1e9);
+                if (ea == eb) return entries.word(a).compare(entries.word(b)) < 0;
+                return ea > eb;
+            });
         }
+    });
+}
+
+
+/* ==================== Re-evaluate thresholds ==================== */
+
+// Every word is a frequency and length anomaly and every prefix an entropy anomaly under
+// open thresholds, so one classification with them yields the complete rankings
+void Analysis::rankEntries() {
+    double freqT = freqThreshold, lenT = lenFreqThreshold, entropyT = entropyThreshold;
+    size_t k = topK;
+
+    freqThreshold = lenFreqThreshold = HUGE_VAL;
+    entropyThreshold = -HUGE_VAL;
+    topK = 0;
+    detectAnomalies();
+    rankedFreq.swap(freqAnomalies);
+    rankedLen.swap(lenAnomalies);
+    rankedEntropy.swap(entropyAnomalies);
+
+    freqThreshold = freqT;
+    lenFreqThreshold = lenT;
+    entropyThreshold = entropyT;
+    topK = k;
+}
+
+// The first call ranks the entries once (O(n log n)); after that each call is a threshold
+// selection plus one pass over the columns, the anomaly lists being prefixes of the rankings
+void Analysis::reclassify(double freqP, double lenP, double entropyP) {
+    freqPercentile = freqP;
+    lenPercentile = lenP;
+    entropyPercentile = entropyP;
+
+    if (rankedFreq.empty() && rankedLen.empty() && rankedEntropy.empty()) rankEntries();
+    computePercentileThresholds();
+    detectAnomalies();
+}
+
+
+/* ==================== Dump / load ==================== */
+
+namespace {
+
+    const char DUMP_MAGIC[8] = { 'T', 'R', 'I', 'E', 'A', 'N', 'L', 4 };
+
+    template <typename T>
+    void put(ofstream &file, const T &value) {
+        file.write((const char*)&value, sizeof value);
     }
 
-    auto compare = [](const AnomalyEntry &a, const AnomalyEntry &b) {
-        if (a.score == b.score) return a.word.compare(b.word) < 0;
-        return a.score < b.score;
+    // Every column starts at a multiple of 8 bytes, so a mapped dump can be used in place
+    const size_t COLUMN_ALIGN = 8;
+
+    // a vector or a Column: its length, padding, then its values
+    template <typename Values>
+    void putColumn(ofstream &file, const Values &column) {
+        static const char padding[COLUMN_ALIGN] = {};
+        put(file, (uint64_t)column.size());
+        file.write(padding, (COLUMN_ALIGN - (size_t)file.tellp() % COLUMN_ALIGN) % COLUMN_ALIGN);
+        file.write((const char*)column.data(), column.size() * sizeof(typename Values::value_type));
+    }
+
+    // Sequential reader over a mapped dump; every read is bounds-checked
+    struct DumpReader {
+        char* data;
+        size_t size;
+        size_t pos = 0;
+        bool ok = true;
+
+        bool take(void* out, size_t bytes) {
+            if (!ok || bytes > size - pos) return ok = false;
+            memcpy(out, data + pos, bytes);
+            pos += bytes;
+            return true;
+        }
+        template <typename T> T get() {
+            T value {};
+            take(&value, sizeof value);
+            return value;
+        }
+        // Values of the next column, nullptr (not ok) if they do not fit in the file
+        template <typename T> T* next(uint64_t &n) {
+            n = get<uint64_t>();
+            pos = min(size, (pos + COLUMN_ALIGN - 1) / COLUMN_ALIGN * COLUMN_ALIGN);
+            if (!ok || n > (size - pos) / sizeof(T)) {
+                ok = false;
+                return nullptr;
+            }
+            T* values = (T*)(data + pos);
+            pos += n * sizeof(T);
+            return values;
+        }
+        // small lists are copied, the entry columns are viewed in place
+        template <typename T> void getColumn(vector<T> &column) {
+            uint64_t n;
+            T* values = next<T>(n);
+            if (values) column.assign(values, values + n);
+        }
+        template <typename T> void getColumn(Column<T> &column) {
+            uint64_t n;
+            T* values = next<T>(n);
+            if (values) column.setView(values, n);
+        }
     };
-    // sort anomalies theo score tăng dần (score càng nhỏ càng hiếm)
-    sort(freqAnomalies.begin(), freqAnomalies.end(), compare);
-    sort(lenAnomalies.begin(), lenAnomalies.end(), compare);
-    sort(entropyAnomalies.begin(), entropyAnomalies.end(), compare);
+}
+
+bool Analysis::dump(const string &file) const {
+    ofstream out(file, ios::binary | ios::trunc);
+    if (!out.is_open()) {
+        cerr << "[ERROR] Failed to open dump file " << file << endl;
+        return false;
+    }
+
+    out.write(DUMP_MAGIC, sizeof DUMP_MAGIC);
+    put(out, (uint8_t)tokenMode);
+    for (unsigned v : { totalInsertedWords, totalUniqueWords, totalNodes, totalUniqueWordChar, totalSymbols,
+                        totalContainers, totalContainerEntries, burstThreshold, maxFreq, minFreq, maxDepth, minDepth })
+        put(out, v);
+    for (double v : { freqPercentile, lenPercentile, entropyPercentile, freqThreshold, lenFreqThreshold, entropyThreshold,
+                      maxEntropy, minEntropy, freqAnomaliesRate, lenAnomaliesRate, entropyAnomaliesRate })
+        put(out, v);
+    for (uint64_t v : { (uint64_t)totalFreqAnomalies, (uint64_t)totalLenAnomalies, (uint64_t)totalEntropyAnomalies,
+                        (uint64_t)topK, (uint64_t)freqSketch.limit() })
+        put(out, v);
+
+    // length histogram sorted by length, so equal states give equal files
+    vector<pair<unsigned, unsigned>> histogram(lenFreq.begin(), lenFreq.end());
+    sort(histogram.begin(), histogram.end());
+    putColumn(out, histogram);
+
+    putColumn(out, entries.counts);
+    putColumn(out, entries.depths);
+    putColumn(out, entries.lenFreqs);
+    putColumn(out, entries.entropies);
+    putColumn(out, entries.freqRates);
+    putColumn(out, entries.isWord);
+    putColumn(out, entries.nodeIds);
+    putColumn(out, entries.categories);
+    putColumn(out, entries.wordOffsets);
+    putColumn(out, entries.wordLengths);
+    putColumn(out, entries.wordPool);
+
+    putColumn(out, freqAnomalies);
+    putColumn(out, lenAnomalies);
+    putColumn(out, entropyAnomalies);
+
+    out.close();
+    if (!out) {
+        cerr << "[ERROR] Failed to write dump file " << file << endl;
+        return false;
+    }
+    cout << "Analysis state is saved at: " << file << endl;
+    return true;
+}
+
+bool Analysis::load(const string &file) {
+    int fd = open(file.c_str(), O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0) {
+        cerr << "[ERROR] Cannot open dump file " << file << endl;
+        if (fd >= 0) close(fd);
+        return false;
+    }
+    // private and writable: reclassify() rewrites categories in place, on copies of those pages only
+    size_t size = info.st_size;
+    void* view = size ? mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (view == MAP_FAILED) {
+        cerr << "[ERROR] Cannot map dump file " << file << endl;
+        return false;
+    }
+    shared_ptr<void> mapping(view, [size](void* p) { munmap(p, size); });
+
+    DumpReader in { (char*)view, size };
+    char magic[sizeof DUMP_MAGIC];
+    in.take(magic, sizeof magic);
+    if (!in.ok || memcmp(magic, DUMP_MAGIC, sizeof magic) != 0) {
+        cerr << "[ERROR] '" << file << "' is not an analysis dump" << endl;
+        return false;
+    }
 
-    // return anomalies;
+    tokenMode = in.get<uint8_t>();
+    for (unsigned* v : { &totalInsertedWords, &totalUniqueWords, &totalNodes, &totalUniqueWordChar, &totalSymbols,
+                         &totalContainers, &totalContainerEntries, &burstThreshold, &maxFreq, &minFreq, &maxDepth, &minDepth })
+        *v = in.get<unsigned>();
+    for (double* v : { &freqPercentile, &lenPercentile, &entropyPercentile, &freqThreshold, &lenFreqThreshold, &entropyThreshold,
+                       &maxEntropy, &minEntropy, &freqAnomaliesRate, &lenAnomaliesRate, &entropyAnomaliesRate })
+        *v = in.get<double>();
+    for (size_t* v : { &totalFreqAnomalies, &totalLenAnomalies, &totalEntropyAnomalies, &topK })
+        *v = in.get<uint64_t>();
+    size_t exactLimit = in.get<uint64_t>();
+
+    vector<pair<unsigned, unsigned>> histogram;
+    in.getColumn(histogram);
+
+    in.getColumn(entries.counts);
+    in.getColumn(entries.depths);
+    in.getColumn(entries.lenFreqs);
+    in.getColumn(entries.entropies);
+    in.getColumn(entries.freqRates);
+    in.getColumn(entries.isWord);
+    in.getColumn(entries.nodeIds);
+    in.getColumn(entries.categories);
+    in.getColumn(entries.wordOffsets);
+    in.getColumn(entries.wordLengths);
+    in.getColumn(entries.wordPool);
+
+    in.getColumn(freqAnomalies);
+    in.getColumn(lenAnomalies);
+    in.getColumn(entropyAnomalies);
+
+    // every column must describe the same entries, and every index must point into them
+    size_t n = entries.counts.size();
+    bool consistent = in.ok;
+    for (size_t m : { entries.depths.size(), entries.lenFreqs.size(), entries.entropies.size(), entries.freqRates.size(),
+                      entries.isWord.size(), entries.nodeIds.size(), entries.categories.size(),
+                      entries.wordOffsets.size(), entries.wordLengths.size() })
+        consistent = consistent && m == n;
+    for (size_t i = 0; consistent && i < n; ++i)
+        consistent = entries.wordOffsets[i] <= entries.wordPool.size() && entries.wordLengths[i] <= entries.wordPool.size() - entries.wordOffsets[i];
+    for (const vector<uint32_t>* list : { &freqAnomalies, &lenAnomalies, &entropyAnomalies })
+        for (size_t j = 0; consistent && j < list->size(); ++j) consistent = (*list)[j] < n;
+    if (!consistent) {
+        cerr << "[ERROR] Dump file " << file << " is truncated or corrupted" << endl;
+        entries.clear();
+        freqAnomalies.clear();
+        lenAnomalies.clear();
+        entropyAnomalies.clear();
+        return false;
+    }
+    entries.mapping = move(mapping);
+
+    lenFreq.clear();
+    lenFreq.insert(histogram.begin(), histogram.end());
+    rankedFreq.clear();
+    rankedLen.clear();
+    rankedEntropy.clear();
+    trie = nullptr;
+
+    // the sketches are refilled from the entries (same values, same limit, hence the same mode)
+    // so reclassify() works on a loaded state; the stored thresholds stay as they were computed
+    freqSketch = QuantileSketch(exactLimit);
+    entropySketch = QuantileSketch(exactLimit);
+    refillSketches();
+
+    cout << "Analysis state is loaded from: " << file << endl;
+    return true;
+}
+
+void Analysis::rebuildTrie(StatTrie &target, SymbolTable &symbols) {
+    if (tokenMode) target.setSymbolTable(&symbols);
+    target.setBurstThreshold(burstThreshold);
+    for (size_t i = 0; i < entries.size(); ++i)
+        if (entries.isWord[i]) target.insert(string(entries.word(i)), entries.counts[i]);
+    trie = &target;
 }
 
 
 /* ==================== Export to csv ==================== */
 
-// Helper: write csv content to file stream
-void Analysis::writeCSVToFilestream (ofstream& file, const vector<AnomalyEntry>& anomalies)  const{
-    file << "String,Kind,Frequency,Length,Length frequency,Entropy,Rate,Anomaly\n";
-    for (const AnomalyEntry& entry : anomalies) {
-        string status;
-        if (entry.count <= freqThreshold) status += "frequency/";
-        if (entry.isWord && lenFreq.at(entry.depth) <= lenFreqThreshold) status += "length/";
-        if (!entry.isWord && entry.entropy >= entropyThreshold) status += "entropy/";
-        if (!status.empty()) status.pop_back();
-        file << escapeCSV(entry.word) << ','
-             << (entry.isWord ? "word" : "prefix") << ','
-             << entry.count << ',' 
-             << entry.depth << ','
-             << (entry.isWord ? lenFreq.at(entry.depth) : 0) << ','
-             << entry.entropy << ','
-             << entry.freqRate << ','
-             << status << '\n';
-    }
+// Helper: write one entry as a csv row
+void Analysis::writeCSVRow (ofstream& file, size_t i) const {
+    bool isWord = entries.isWord[i];
+    string status;
+    if (entries.counts[i] <= freqThreshold) status += "frequency/";
+    if (isWord && entries.lenFreqs[i] <= lenFreqThreshold) status += "length/";
+    if (!isWord && entries.entropies[i] >= entropyThreshold) status += "entropy/";
+    if (!status.empty()) status.pop_back();
+    file << escapeCSV(entries.word(i)) << ','
+         << (isWord ? "word" : "prefix") << ','
+         << entries.counts[i] << ','
+         << entries.depths[i] << ','
+         << entries.lenFreqs[i] << ','
+         << entries.entropies[i] << ','
+         << entries.freqRates[i] << ','
+         << status << '\n';
 }
 
 
 void Analysis::exportCSV(const string exportFile, char mode) const {
+    const vector<uint32_t> *indices = nullptr;
+
+    if (mode == 'f') indices = &freqAnomalies;
+    else if (mode == 'l') indices = &lenAnomalies;
+    else if (mode == 'e') indices = &entropyAnomalies;
+    else if (mode != 'a') {
+        cerr << "[ERROR] Unsupported mode" << endl;
+        return;
+    }
+
     ofstream fout;
     fout.open(exportFile, ios::trunc);
     if (!fout.is_open()) {
         cerr << "[ERROR] Failed to export anomalies to " << exportFile << endl;
         return;
     }
-    const vector<AnomalyEntry> *entries = nullptr;
-
-    if (mode == 'a') {
-        entries = &allEntries;
-    }
-    else if (mode == 'f') {
-        entries = &freqAnomalies;
-    }
-    else if (mode == 'l') {
-        entries = &lenAnomalies;
-    }
-    else if (mode == 'e') {
-        entries = &entropyAnomalies;
-    }
-    else cerr << "[ERROR] Unsupported mode" << endl;
 
-    writeCSVToFilestream(fout, *entries);
+    fout << "String,Kind,Frequency,Length,Length frequency,Entropy,Rate,Anomaly\n";
+    if (indices) for (uint32_t i : *indices) writeCSVRow(fout, i);
+    else for (size_t i = 0; i < entries.size(); ++i) writeCSVRow(fout, i);
     fout.close();
 
     cout << "CSV is saved at: " << exportFile << endl;
@@ -270,12 +843,12 @@ void Analysis::exportCSV(const string exportFile, char mode) const {
 
 /* ==================== Helper: format string to put in csv ==================== */
 
-string Analysis::escapeCSV(const std::string& s) const {
+string Analysis::escapeCSV(std::string_view s) const {
     bool needQuotes = s.find(',') != std::string::npos ||
                       s.find('"') != std::string::npos ||
                       s.find('\n') != std::string::npos;
 
-    std::string out = s;
+    std::string out(s);
     // replace " with ""
     size_t pos = 0;
     while ((pos = out.find('"', pos)) != std::string::npos) {
@@ -307,8 +880,14 @@ void Analysis::exportReport(const string exportFile) const {
          << "- Total unique words: " << totalUniqueWords << '\n'
          << "- Total unique-word characters: " << totalUniqueWordChar << '\n'
          << "- Total nodes: " << totalNodes << '\n'
-         << "- Compressed rate (total unique-word characters / total nodes): " << (double)totalUniqueWordChar/totalNodes << '\n'
-         << "\n----------------------- Extremum statistics ------------------------\n\n"
+         << "- Compressed rate (total unique-word characters / total nodes): " << (double)totalUniqueWordChar/totalNodes << '\n';
+    if (totalSymbols)
+        file << "- Token mode: " << totalSymbols << " interned tokens (lengths and characters are counted in tokens)\n";
+    if (burstThreshold)
+        file << "- Burst containers: " << totalContainers << " holding " << totalContainerEntries
+             << " suffixes (nodes above count real nodes only)\n";
+
+    file << "\n----------------------- Extremum statistics ------------------------\n\n"
          << "Word frequency:\n"
          << "- Max frequency: " << maxFreq << '\n'
          << "- Min frequency: " << minFreq << "\n\n"
@@ -323,36 +902,39 @@ void Analysis::exportReport(const string exportFile) const {
 
          << "\n-------------------- ANOMALIES DETECTION --------------------"
          << "\n\n-------------------------- Thresholds ----------------------------\n\n"
-         << "- Word frequency threshold (" << freqPercentile << "% lower percentile): " << freqThreshold << '\n'
+         << "- Word frequency threshold (" << freqPercentile << "% lower percentile): " << freqThreshold
+         << (freqSketch.isExact() ? "" : " (approximate, KLL sketch)") << '\n'
          << "- Length frequency threshold (" << lenPercentile << "% lower percentile): " << lenFreqThreshold << '\n'
          << "- Entropy threshold (" << entropyPercentile << "% upper percentile): " << entropyThreshold
-         
-         << "\n\n-------------------- Anomalies: frequency-based --------------------\n\n";
+         << (entropySketch.isExact() ? "" : " (approximate, KLL sketch)");
+    if (topK)
+        file << "\n- Top-K mode: only the " << topK << " rarest anomalies per metric are listed and exported";
+    file << "\n\n-------------------- Anomalies: frequency-based --------------------\n\n";
 
     size_t n = freqAnomalies.size() > 8 ? 8 : freqAnomalies.size();
     for (size_t i = 0; i < n; ++i) 
-        file << freqAnomalies[i].word << ", frequency = " << freqAnomalies[i].count << '\n';
-    if (n < freqAnomalies.size()) file << "...\n";
-    file << "\nThere are " << freqAnomalies.size() << " frequency-based anomalies\n"
+        file << entries.word(freqAnomalies[i]) << ", frequency = " << entries.counts[freqAnomalies[i]] << '\n';
+    if (n < totalFreqAnomalies) file << "...\n";
+    file << "\nThere are " << totalFreqAnomalies << " frequency-based anomalies\n"
          << "Accounted for " << freqAnomaliesRate*100 << "% of the processed text"
     
          << "\n\n------------------ Anomalies: length-frequency-based -------------------\n\n";
 
     n = lenAnomalies.size() > 8 ? 8 : lenAnomalies.size();
     for (size_t i = 0; i < n; ++i) 
-        file << lenAnomalies[i].word << ", length = " << lenAnomalies[i].depth
-             << ", length frequency = " << lenFreq.at(lenAnomalies[i].depth) << ", frequency = " << lenAnomalies[i].count << '\n';
-    if (n < lenAnomalies.size()) file << "...\n";
-    file << "\nThere are " << lenAnomalies.size() << " length-frequency-based anomalies\n"
+        file << entries.word(lenAnomalies[i]) << ", length = " << entries.depths[lenAnomalies[i]]
+             << ", length frequency = " << entries.lenFreqs[lenAnomalies[i]] << ", frequency = " << entries.counts[lenAnomalies[i]] << '\n';
+    if (n < totalLenAnomalies) file << "...\n";
+    file << "\nThere are " << totalLenAnomalies << " length-frequency-based anomalies\n"
          << "Accounted for " << lenAnomaliesRate*100 << "% of the processed text"
 
          << "\n\n------------------ Anomalies: entropy-based -------------------\n\n";
 
     n = entropyAnomalies.size() > 8 ? 8 : entropyAnomalies.size();
     for (size_t i = 0; i < n; ++i) 
-        file << entropyAnomalies[i].word << ", entropy = " << entropyAnomalies[i].entropy << ", frequency = " << entropyAnomalies[i].count << '\n';
-    if (n < entropyAnomalies.size()) file << "...\n";
-    file << "\nThere are " << entropyAnomalies.size() << " entropy-based anomalies\n"
+        file << entries.word(entropyAnomalies[i]) << ", entropy = " << entries.entropies[entropyAnomalies[i]] << ", frequency = " << entries.counts[entropyAnomalies[i]] << '\n';
+    if (n < totalEntropyAnomalies) file << "...\n";
+    file << "\nThere are " << totalEntropyAnomalies << " entropy-based anomalies\n"
          << "Accounted for " << entropyAnomaliesRate*100 << "% of the processed text"
 
          << "\n\n======================= END OF REPORT =============================";
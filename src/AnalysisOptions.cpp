@@ -0,0 +1,198 @@
+#include "AnalysisOptions.h"
+#include "Entropy.h"
+#include <iostream>
+#include <sstream>
+#include <chrono>
+#include <cmath>
+#include <unordered_set>
+using namespace std;
+
+
+namespace {
+
+    // Print node layout statistics and the time of a full traversal
+    void printLayout (const string &title, const StatTrie &trie) {
+        LayoutStatistics stats = trie.layoutStatistics();
+        unsigned visited = 0;
+        auto start = chrono::steady_clock::now();
+        trie.traverse ([&](const Node*, const string&) { ++visited; });
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+        cout << "Node layout (" << title << "): "
+             << stats.nodes << " nodes in " << stats.blocks << " blocks, "
+             << stats.freeSlots << " free slots, "
+             << stats.sequentialRate * 100 << "% sequential DFS steps, "
+             << "mean jump " << stats.meanJump << " bytes, "
+             << "traversal " << ms << " ms" << endl;
+    }
+
+    // Compare the entropy kernel (maintained aggregates and gathered counts) against the
+    // per-child floating-point formula on every node; returns false beyond tolerance
+    bool verifyEntropy (const StatTrie &trie, double tolerance) {
+        double maxAggregate = 0, maxGathered = 0;
+        unsigned checked = 0;
+        vector<unsigned> counts;
+
+        trie.traverse ([&](const Node* node, const string&) {
+            if (node->count == 0) return;
+            counts.assign (1, node->countEnd());
+            for (auto &p : node->children) counts.push_back (p.second->count);
+
+            double reference = 0, total = node->count;
+            for (unsigned c : counts) {
+                if (c == 0) continue;
+                double p_i = c / total;
+                reference -= p_i * log2 (p_i);
+            }
+            size_t outcomes = node->children.size() + (node->countEnd() > 0);
+            double aggregate = outcomes < 2 ? 0 : entropy::localEntropy (node->count, node->entropySum);
+            double gathered = entropy::localEntropy (counts.data(), counts.size());
+
+            maxAggregate = max (maxAggregate, fabs (aggregate - reference));
+            maxGathered = max (maxGathered, fabs (gathered - reference));
+            ++checked;
+        });
+
+        cout << "Entropy kernel check on " << checked << " nodes (AVX2 " << (entropy::hasAVX2() ? "on" : "off") << "): "
+             << "max deviation " << maxAggregate << " (aggregates), " << maxGathered << " (gathered counts), "
+             << "tolerance " << tolerance << endl;
+        return maxAggregate <= tolerance && maxGathered <= tolerance;
+    }
+
+    bool startsWith (const string &str, const string &prefix) {
+        return str.size() >= prefix.size() && str.compare (0, prefix.size(), prefix) == 0;
+    }
+
+}
+
+
+/* ---------- OPTIONS ---------- */
+
+int AnalysisOptions::parse (const string &arg) {
+    string value;
+    auto valueOf = [&](const string &name) {
+        if (!startsWith (arg, name + "=")) return false;
+        value = arg.substr (name.size() + 1);
+        return true;
+    };
+
+    try {
+        if (valueOf ("--perc-freq"))            percFreq = stod (value);
+        else if (valueOf ("--perc-len"))        percLen = stod (value);
+        else if (valueOf ("--perc-entropy"))    percEntropy = stod (value);
+        else if (valueOf ("--exact-limit"))     exactLimit = stoul (value);
+        else if (valueOf ("--threads"))         threads = stoul (value);
+        else if (valueOf ("--top"))             topK = stoul (value);
+        else if (valueOf ("--burst"))           burstThreshold = stoul (value);
+        else if (valueOf ("--dump"))            dumpFile = value;
+        else if (valueOf ("--sweep")) {
+            // triples are separated by ',' and their values by ':'
+            stringstream list (value);
+            string triple;
+            while (getline (list, triple, ',')) {
+                stringstream parts (triple);
+                string part, label;
+                vector<double> percentiles;
+                try {
+                    while (getline (parts, part, ':')) {
+                        percentiles.push_back (stod (part));
+                        label += (label.empty() ? "" : "_") + part;
+                    }
+                } catch (...) {
+                    percentiles.clear();
+                }
+                if (percentiles.size() != 3) {
+                    cerr << "[ERROR] Invalid percentile triple for --sweep: " << triple << endl;
+                    return -1;
+                }
+                sweeps.push_back (percentiles);
+                sweepLabels.push_back (label);
+            }
+        }
+        else if (arg == "--tokens")             tokenMode = true;
+        else if (arg == "--compact")            compact = true;
+        else if (arg == "--verify-entropy")     verifyEntropy = true;
+        else if (arg == "--json-complete")      jsonComplete = true;
+        else if (arg == "--json-partial")       jsonPartial = true;
+        else if (arg == "--json-freq")          jsonFreq = true;
+        else if (arg == "--json-len")           jsonLen = true;
+        else if (arg == "--json-entropy")       jsonEntropy = true;
+        else return 0;
+    } catch (...) {
+        cerr << "[ERROR] Invalid value for " << arg.substr (0, arg.find ('=')) << ": " << arg << endl;
+        return -1;
+    }
+    flags.push_back (arg);
+    return 1;
+}
+
+bool AnalysisOptions::wantsJSON() const {
+    return jsonComplete || jsonPartial || jsonFreq || jsonLen || jsonEntropy;
+}
+
+void AnalysisOptions::configure (Analysis &a) const {
+    a.setQuantileExactLimit (exactLimit);
+    a.setThreads (threads);
+    a.setTopK (topK);
+}
+
+bool AnalysisOptions::configure (StatTrie &trie, SymbolTable &symbols) const {
+    if (burstThreshold && tokenMode) {
+        cerr << "[ERROR] --burst is only supported for character tries" << endl;
+        return false;
+    }
+    trie.setBurstThreshold (burstThreshold);
+    if (tokenMode) trie.setSymbolTable (&symbols);
+    return true;
+}
+
+
+/* ---------- DRIVER ---------- */
+
+bool runAnalysis (const AnalysisOptions &options, StatTrie &trie, Analysis &a, const string &outputDir) {
+    if (options.compact) {
+        printLayout ("before compact", trie);
+        trie.compact();
+        printLayout ("after compact", trie);
+    }
+    if (options.verifyEntropy && !verifyEntropy (trie, 1e-9)) {
+        cerr << "[ERROR] Entropy kernel deviates from the reference implementation" << endl;
+        return false;
+    }
+    a.collectStatistics (&trie);
+    return exportAnalysis (options, trie, a, outputDir);
+}
+
+bool exportAnalysis (const AnalysisOptions &options, StatTrie &trie, Analysis &a, const string &outputDir) {
+    if (!options.dumpFile.empty() && !a.dump (options.dumpFile)) return false;
+
+    a.exportReport (outputDir + "/overall_report.txt");
+    a.exportCSV (outputDir + "/all_entries.csv");
+    a.exportCSV (outputDir + "/frequency_anomalies.csv", 'f');
+    a.exportCSV (outputDir + "/length_anomalies.csv", 'l');
+    a.exportCSV (outputDir + "/entropy_anomalies.csv", 'e');
+
+    // complete and partial share the set of all anomalies, the others take one metric each
+    if (options.jsonComplete || options.jsonPartial) {
+        unordered_set<const Node*> nodes;
+        a.markAnomalyNodes (nodes);
+        if (options.jsonComplete) trie.exportAllJSON (outputDir + "/" + FN_JSON_COMPLETE, nodes);
+        if (options.jsonPartial) trie.exportPartialJSON (outputDir + "/" + FN_JSON_PARTIAL, nodes);
+    }
+    const char modes[] = { 'f', 'l', 'e' };
+    const bool wanted[] = { options.jsonFreq, options.jsonLen, options.jsonEntropy };
+    const string* names[] = { &FN_JSON_FREQ, &FN_JSON_LEN, &FN_JSON_ENTROPY };
+    for (int m = 0; m < 3; ++m) {
+        if (!wanted[m]) continue;
+        unordered_set<const Node*> nodes;
+        a.markAnomalyNodes (nodes, modes[m]);
+        trie.exportPartialJSON (outputDir + "/" + *names[m], nodes);
+    }
+
+    // threshold sweep: re-evaluate the collected statistics, no rebuild
+    for (size_t i = 0; i < options.sweeps.size(); ++i) {
+        a.reclassify (options.sweeps[i][0], options.sweeps[i][1], options.sweeps[i][2]);
+        a.exportReport (outputDir + "/report_" + options.sweepLabels[i] + ".txt");
+    }
+    return true;
+}
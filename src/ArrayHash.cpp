@@ -0,0 +1,145 @@
+#include "ArrayHash.h"
+#include <cstring>
+#include <algorithm>
+using namespace std;
+
+
+/* ---------- CONSTRUCTORS ---------- */
+
+ArrayHash::ArrayHash (size_t slotCount) :
+    slots(slotCount),
+    countEntries(0),
+    countTotal(0) {}
+
+
+/* ---------- HELPERS ---------- */
+
+static inline uint32_t readU32 (const char* p) {
+    uint32_t v;
+    memcpy (&v, p, sizeof v);
+    return v;
+}
+
+static inline void writeU32 (char* p, uint32_t v) {
+    memcpy (p, &v, sizeof v);
+}
+
+// FNV-1a, 32 bit
+uint32_t ArrayHash::hash (string_view key) {
+    uint32_t h = 2166136261u;
+    for (char c : key) {
+        h ^= (unsigned char)c;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+string& ArrayHash::slotOf (string_view key) {
+    return slots[hash(key) % slots.size()];
+}
+
+const string& ArrayHash::slotOf (string_view key) const {
+    return slots[hash(key) % slots.size()];
+}
+
+// Offset of the record holding key inside slot, npos if absent
+size_t ArrayHash::findRecord (const string& slot, string_view key) {
+    const char* data = slot.data();
+    size_t pos = 0;
+    while (pos < slot.size()) {
+        uint32_t len = readU32 (data + pos);
+        if (len == key.size() && memcmp (data + pos + 4, key.data(), len) == 0) return pos;
+        pos += 8 + len;
+    }
+    return string::npos;
+}
+
+
+/* ---------- BASIC METHODS ---------- */
+
+bool ArrayHash::add (string_view key, unsigned num) {
+    string& slot = slotOf (key);
+    countTotal += num;
+
+    size_t pos = findRecord (slot, key);
+    if (pos != string::npos) {
+        char* cnt = &slot[pos + 4 + key.size()];
+        writeU32 (cnt, readU32(cnt) + num);
+        return false;
+    }
+
+    size_t end = slot.size();
+    slot.resize (end + 8 + key.size());
+    writeU32 (&slot[end], key.size());
+    memcpy (&slot[end + 4], key.data(), key.size());
+    writeU32 (&slot[end + 4 + key.size()], num);
+    ++countEntries;
+    return true;
+}
+
+unsigned ArrayHash::find (string_view key) const {
+    const string& slot = slotOf (key);
+    size_t pos = findRecord (slot, key);
+    if (pos == string::npos) return 0;
+    return readU32 (slot.data() + pos + 4 + key.size());
+}
+
+unsigned ArrayHash::erase (string_view key) {
+    string& slot = slotOf (key);
+    size_t pos = findRecord (slot, key);
+    if (pos == string::npos) return 0;
+
+    unsigned num = readU32 (slot.data() + pos + 4 + key.size());
+    slot.erase (pos, 8 + key.size());
+    --countEntries;
+    countTotal -= num;
+    return num;
+}
+
+bool ArrayHash::hasPrefix (string_view prefix) const {
+    for (const string& slot : slots) {
+        const char* data = slot.data();
+        for (size_t pos = 0; pos < slot.size(); ) {
+            uint32_t len = readU32 (data + pos);
+            if (len >= prefix.size() && memcmp (data + pos + 4, prefix.data(), prefix.size()) == 0) return true;
+            pos += 8 + len;
+        }
+    }
+    return false;
+}
+
+
+/* ---------- STATISTICAL METHODS ---------- */
+
+size_t ArrayHash::size() const {
+    return countEntries;
+}
+
+unsigned ArrayHash::totalCount() const {
+    return countTotal;
+}
+
+size_t ArrayHash::memoryUsage() const {
+    size_t bytes = sizeof(ArrayHash) + slots.capacity() * sizeof(string);
+    for (const string& slot : slots) bytes += slot.capacity();
+    return bytes;
+}
+
+void ArrayHash::forEach (const function<void(string_view, unsigned)> &callback) const {
+    for (const string& slot : slots) {
+        const char* data = slot.data();
+        for (size_t pos = 0; pos < slot.size(); ) {
+            uint32_t len = readU32 (data + pos);
+            callback (string_view (data + pos + 4, len), readU32 (data + pos + 4 + len));
+            pos += 8 + len;
+        }
+    }
+}
+
+vector<pair<string_view, unsigned>> ArrayHash::sortedEntries() const {
+    vector<pair<string_view, unsigned>> entries;
+    entries.reserve (countEntries);
+    forEach ([&] (string_view key, unsigned num) { entries.emplace_back (key, num); });
+    sort (entries.begin(), entries.end());
+    return entries;
+}
@@ -0,0 +1,127 @@
+#include "Entropy.h"
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define ENTROPY_X86 1
+#endif
+
+
+namespace entropy {
+
+    double nlog2nTable[TABLE_SIZE];
+
+    /* ---------- Tables ---------- */
+
+    // log2 and inverse of 1 + j/256, the mantissa split used by fastLog2
+    static const int MANTISSA_BITS = 8;
+    static double log2Mantissa[1 << MANTISSA_BITS];
+    static double invMantissa[1 << MANTISSA_BITS];
+
+    static bool initTables() {
+        nlog2nTable[0] = 0;
+        for (unsigned c = 1; c < TABLE_SIZE; ++c) nlog2nTable[c] = c * std::log2((double)c);
+        for (int j = 0; j < (1 << MANTISSA_BITS); ++j) {
+            double m = 1.0 + (double)j / (1 << MANTISSA_BITS);
+            log2Mantissa[j] = std::log2(m);
+            invMantissa[j] = 1.0 / m;
+        }
+        return true;
+    }
+
+    [[maybe_unused]] static const bool tablesReady = initTables();
+
+
+    /* ---------- Scalar kernel ---------- */
+
+    // x = 2^e * m, m = m0 * (1 + r) with m0 from the top mantissa bits and 0 <= r < 2^-8,
+    // log2(1 + r) from a short series
+    double fastLog2 (double x) {
+        uint64_t bits;
+        memcpy (&bits, &x, sizeof bits);
+        int e = (int)((bits >> 52) & 0x7FF) - 1023;
+        unsigned j = (unsigned)((bits >> (52 - MANTISSA_BITS)) & ((1 << MANTISSA_BITS) - 1));
+
+        uint64_t mbits = (bits & ((1ULL << 52) - 1)) | (1023ULL << 52);
+        double m;
+        memcpy (&m, &mbits, sizeof m);
+
+        double r = m * invMantissa[j] - 1.0;
+        double series = r * (1.0 + r * (-1.0/2 + r * (1.0/3 + r * (-1.0/4 + r * (1.0/5)))));
+        return e + log2Mantissa[j] + series * 1.4426950408889634; // 1 / ln 2
+    }
+
+    static double sumNLog2NScalar (const unsigned* counts, size_t n) {
+        double sum = 0;
+        for (size_t i = 0; i < n; ++i) sum += nlog2n (counts[i]);
+        return sum;
+    }
+
+
+    /* ---------- AVX2 kernel ---------- */
+
+#ifdef ENTROPY_X86
+    __attribute__((target("avx2")))
+    static double sumNLog2NAVX2 (const unsigned* counts, size_t n) {
+        __m256d acc0 = _mm256_setzero_pd();
+        __m256d acc1 = _mm256_setzero_pd();
+        const __m256i maxSmall = _mm256_set1_epi32 (TABLE_SIZE - 1);
+        const __m256d all = _mm256_castsi256_pd (_mm256_set1_epi64x (-1));
+        double rest = 0;
+
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8) {
+            __m256i c = _mm256_loadu_si256 ((const __m256i*)(counts + i));
+            __m256i small = _mm256_cmpeq_epi32 (_mm256_min_epu32 (c, maxSmall), c);
+            if (_mm256_movemask_epi8 (small) == -1) {
+                acc0 = _mm256_add_pd (acc0, _mm256_mask_i32gather_pd (acc0, nlog2nTable, _mm256_castsi256_si128 (c), all, 8));
+                acc1 = _mm256_add_pd (acc1, _mm256_mask_i32gather_pd (acc1, nlog2nTable, _mm256_extracti128_si256 (c, 1), all, 8));
+            }
+            else rest += sumNLog2NScalar (counts + i, 8);
+        }
+        rest += sumNLog2NScalar (counts + i, n - i);
+
+        double lanes[4];
+        _mm256_storeu_pd (lanes, _mm256_add_pd (acc0, acc1));
+        return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]) + rest;
+    }
+#endif
+
+    bool hasAVX2() {
+#ifdef ENTROPY_X86
+        static const bool supported = __builtin_cpu_supports ("avx2");
+        return supported;
+#else
+        return false;
+#endif
+    }
+
+    double sumNLog2N (const unsigned* counts, size_t n) {
+#ifdef ENTROPY_X86
+        if (n >= 8 && hasAVX2()) return sumNLog2NAVX2 (counts, n);
+#endif
+        return sumNLog2NScalar (counts, n);
+    }
+
+
+    /* ---------- Entropy ---------- */
+
+    double localEntropy (unsigned total, double sumNLog2N) {
+        if (total == 0) return 0;
+        double H = fastLog2 (total) - sumNLog2N / total;
+        return H > 0 ? H : 0;
+    }
+
+    double localEntropy (const unsigned* counts, size_t n) {
+        unsigned total = 0;
+        size_t outcomes = 0;
+        for (size_t i = 0; i < n; ++i) {
+            total += counts[i];
+            outcomes += counts[i] > 0;
+        }
+        if (outcomes < 2) return 0;
+        return localEntropy (total, sumNLog2N (counts, n));
+    }
+}
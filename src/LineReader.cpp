@@ -0,0 +1,400 @@
+#include "LineReader.h"
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+#ifdef SCAD_HAVE_ZSTD
+#include <zstd.h>
+#endif
+using namespace std;
+
+
+namespace {
+
+    enum Format { PLAIN, GZIP, ZSTD };
+
+    Format detect (const char* head, size_t size) {
+        if (size >= 2 && (unsigned char)head[0] == 0x1f && (unsigned char)head[1] == 0x8b) return GZIP;
+        if (size >= 4 && memcmp (head, "\x28\xb5\x2f\xfd", 4) == 0) return ZSTD;
+        return PLAIN;
+    }
+
+    bool supported (Format format, const string &file) {
+#ifndef SCAD_HAVE_ZSTD
+        if (format == ZSTD) {
+            cerr << "[ERROR] '" << file << "' is zstd-compressed: rebuild with -DSCAD_HAVE_ZSTD -lzstd to read it" << endl;
+            return false;
+        }
+#endif
+        (void)format;
+        (void)file;
+        return true;
+    }
+
+}
+
+
+/* ---------- DECOMPRESSION ---------- */
+
+// The worker reads the input and queues blocks of decompressed bytes, at most QUEUED ahead of
+// the reader; the reader hands its used blocks back for reuse. Plain pipes go through the same
+// queue with the bytes as they are, so they never have to fit in memory either.
+struct LineReader::Inflater {
+
+    static constexpr size_t BLOCK_SIZE = 1 << 20;
+    static constexpr size_t QUEUED = 4;
+
+    int fd;
+    Format format;
+    string pending;               // bytes read before the format was known
+    string name;
+
+    mutex lock;
+    condition_variable changed;
+    deque<string> ready, spare;
+    bool finished = false;        // no block will be added
+    bool stopping = false;        // the reader closed early
+    int error = 0;                // errno of a failed read
+    thread worker;
+
+    Inflater (int input, Format type, string head, const string &file)
+        : fd (input), format (type), pending (move (head)), name (file) {
+        worker = thread ([this]() { run(); });
+    }
+
+    ~Inflater() {
+        {
+            lock_guard<mutex> guard (lock);
+            stopping = true;
+        }
+        changed.notify_all();
+        worker.join();
+        if (fd != STDIN_FILENO) ::close (fd);
+    }
+
+    // Next compressed bytes into in; false at end of file
+    bool readInput (string &in) {
+        if (!pending.empty()) {
+            in.swap (pending);
+            pending.clear();
+            return true;
+        }
+        in.resize (1 << 18);
+        ssize_t n;
+        while ((n = read (fd, &in[0], in.size())) < 0 && errno == EINTR) {}
+        in.resize (n > 0 ? n : 0);
+        return n > 0;
+    }
+
+    // Nothing queued: the reader is (about to be) waiting for bytes
+    bool starved() {
+        lock_guard<mutex> guard (lock);
+        return ready.empty();
+    }
+
+    // Queue a block, waiting for room; false if the reader is gone
+    bool push (string &block) {
+        unique_lock<mutex> guard (lock);
+        changed.wait (guard, [this]() { return stopping || ready.size() < QUEUED; });
+        if (stopping) return false;
+        ready.push_back (move (block));
+        if (!spare.empty()) {
+            block = move (spare.front());
+            spare.pop_front();
+        }
+        else block = string();
+        changed.notify_all();
+        return true;
+    }
+
+    void run() {
+        string block, in;
+        block.reserve (BLOCK_SIZE);
+        bool ok = format == PLAIN ? copyPlain (block)
+                : format == GZIP ? inflateGzip (block, in) : inflateZstd (block, in);
+        if (ok && !block.empty()) push (block);
+        lock_guard<mutex> guard (lock);
+        if (!ok && !stopping) {
+            if (format == PLAIN) cerr << "[ERROR] Cannot read '" << name << "': " << strerror (error) << endl;
+            else cerr << "[ERROR] Cannot decompress '" << name << "': the input is corrupt or truncated" << endl;
+        }
+        finished = true;
+        changed.notify_all();
+    }
+
+    // Identity "decoder": bytes are read straight into the block. A partial block is queued
+    // as soon as the reader runs dry, so lines from a slow pipe are not held back.
+    bool copyPlain (string &block) {
+        block.swap (pending);
+        while (true) {
+            if (!block.empty() && (block.size() == BLOCK_SIZE || starved()) && !push (block)) return true;
+            size_t used = block.size();
+            block.resize (BLOCK_SIZE);
+            ssize_t n;
+            while ((n = read (fd, &block[used], BLOCK_SIZE - used)) < 0 && errno == EINTR) {}
+            block.resize (used + (n > 0 ? n : 0));
+            if (n < 0) error = errno;
+            if (n <= 0) return n == 0;
+        }
+    }
+
+    // Gzip members one after the other (as written by cat a.gz b.gz), zlib streams too
+    bool inflateGzip (string &block, string &in) {
+        z_stream z;
+        memset (&z, 0, sizeof z);
+        if (inflateInit2 (&z, 15 + 32) != Z_OK) return false;
+        bool ok = true, member = false;
+        while (ok && readInput (in)) {
+            z.next_in = (Bytef*)in.data();
+            z.avail_in = in.size();
+            // a full output block may leave decompressed bytes behind even with no input left
+            bool full = false;
+            while (z.avail_in > 0 || full) {
+                if (block.size() == BLOCK_SIZE && !push (block)) {
+                    inflateEnd (&z);
+                    return true;
+                }
+                size_t used = block.size();
+                block.resize (BLOCK_SIZE);
+                z.next_out = (Bytef*)&block[used];
+                z.avail_out = BLOCK_SIZE - used;
+                int status = inflate (&z, Z_NO_FLUSH);
+                full = z.avail_out == 0;
+                block.resize (BLOCK_SIZE - z.avail_out);
+                member = status != Z_STREAM_END;
+                if (status == Z_STREAM_END) inflateReset (&z);
+                else if (status != Z_OK && status != Z_BUF_ERROR) {
+                    ok = false;
+                    break;
+                }
+            }
+        }
+        inflateEnd (&z);
+        return ok && !member;
+    }
+
+    bool inflateZstd (string &block, string &in) {
+#ifdef SCAD_HAVE_ZSTD
+        ZSTD_DStream* stream = ZSTD_createDStream();
+        if (!stream) return false;
+        bool ok = true;
+        size_t remaining = 0;  // 0 once a frame is complete
+        while (ok && readInput (in)) {
+            ZSTD_inBuffer input = { in.data(), in.size(), 0 };
+            bool full = false;
+            while (input.pos < input.size || full) {
+                if (block.size() == BLOCK_SIZE && !push (block)) {
+                    ZSTD_freeDStream (stream);
+                    return true;
+                }
+                size_t used = block.size();
+                block.resize (BLOCK_SIZE);
+                ZSTD_outBuffer output = { &block[0], BLOCK_SIZE, used };
+                remaining = ZSTD_decompressStream (stream, &output, &input);
+                full = output.pos == BLOCK_SIZE;
+                block.resize (output.pos);
+                if (ZSTD_isError (remaining)) {
+                    ok = false;
+                    break;
+                }
+            }
+        }
+        ZSTD_freeDStream (stream);
+        return ok && remaining == 0;
+#else
+        (void)block;
+        (void)in;
+        return false;
+#endif
+    }
+
+    // Next block for the reader; false once everything was handed out
+    bool pop (string &block) {
+        unique_lock<mutex> guard (lock);
+        changed.wait (guard, [this]() { return finished || !ready.empty(); });
+        if (ready.empty()) return false;
+        block = move (ready.front());
+        ready.pop_front();
+        changed.notify_all();
+        return true;
+    }
+
+    // A block the reader is done with, reused by the worker
+    void recycle (string &block) {
+        if (!block.capacity()) return;
+        block.clear();
+        lock_guard<mutex> guard (lock);
+        if (spare.size() < QUEUED) spare.push_back (move (block));
+    }
+};
+
+
+/* ---------- CONSTRUCTORS ---------- */
+
+LineReader::LineReader() : data(nullptr), length(0), position(0), scanned(0), dropped(0), mapped(false) {}
+
+LineReader::~LineReader() {
+    close();
+}
+
+
+/* ---------- BASIC METHODS ---------- */
+
+bool LineReader::open (const string &file) {
+    close();
+    int fd = file == "-" ? STDIN_FILENO : ::open (file.c_str(), O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat (fd, &info) != 0) {
+        if (fd > STDIN_FILENO) ::close (fd);
+        return false;
+    }
+
+    if (S_ISREG (info.st_mode) && info.st_size > 0) {
+        char head[4];
+        ssize_t got = pread (fd, head, sizeof head, 0);
+        Format format = detect (head, got > 0 ? got : 0);
+        if (!supported (format, file)) {
+            ::close (fd);
+            return false;
+        }
+        if (format != PLAIN) {
+            inflater = make_unique<Inflater> (fd, format, string(), file);
+            data = buffer.data();
+            return true;
+        }
+
+        void* view = mmap (nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (view != MAP_FAILED) {
+            madvise (view, info.st_size, MADV_SEQUENTIAL);
+            data = (const char*)view;
+            length = info.st_size;
+            mapped = true;
+            if (fd != STDIN_FILENO) ::close (fd);
+            return true;
+        }
+    }
+
+    // not mappable (pipes, stdin): the first bytes tell whether the stream is compressed, then
+    // the worker thread reads it block by block either way
+    string head;
+    char chunk[1 << 16];
+    ssize_t n = 0;
+    while (head.size() < 4) {
+        while ((n = read (fd, chunk, sizeof chunk)) < 0 && errno == EINTR) {}
+        if (n <= 0) break;
+        head.append (chunk, n);
+    }
+    if (n < 0) {
+        if (fd != STDIN_FILENO) ::close (fd);
+        return false;
+    }
+    Format format = detect (head.data(), head.size());
+    if (!supported (format, file)) {
+        if (fd != STDIN_FILENO) ::close (fd);
+        return false;
+    }
+    inflater = make_unique<Inflater> (fd, format, move (head), file);
+    data = buffer.data();
+    return true;
+}
+
+void LineReader::close() {
+    inflater.reset();
+    if (mapped) munmap ((void*)data, length);
+    buffer.clear();
+    buffer.shrink_to_fit();
+    data = nullptr;
+    length = position = scanned = dropped = 0;
+    mapped = false;
+}
+
+bool LineReader::refill() {
+    string block;
+    if (!inflater->pop (block)) {
+        inflater.reset();
+        return false;
+    }
+    buffer.erase (0, position);
+    dropped += position;
+    scanned -= position;
+    position = 0;
+    if (buffer.empty()) buffer.swap (block);
+    else buffer.append (block);
+    inflater->recycle (block);
+    data = buffer.data();
+    length = buffer.size();
+    return true;
+}
+
+bool LineReader::next (string_view &line) {
+    while (true) {
+        if (position < length) {
+            size_t from = max (position, scanned);
+            const char* end = (const char*)memchr (data + from, '\n', length - from);
+            if (end || !inflater) {
+                if (!end) end = data + length;
+                line = string_view (data + position, end - (data + position));
+                position = end - data + 1;
+                scanned = position;
+                return true;
+            }
+            scanned = length;
+        }
+        else if (!inflater) return false;
+        if (!refill()) continue;
+    }
+}
+
+bool LineReader::lineReady() const {
+    if (!inflater) return true;
+    size_t from = max (position, scanned);
+    return from < length && memchr (data + from, '\n', length - from);
+}
+
+bool LineReader::nextBlock (size_t size, string_view &block) {
+    size_t end;
+    while (true) {
+        end = position + size;
+        if (end < length) {
+            const char* newline = (const char*)memchr (data + end - 1, '\n', length - end + 1);
+            if (newline) {
+                end = newline - data + 1;
+                break;
+            }
+        }
+        if (!inflater) {
+            end = length;
+            break;
+        }
+        refill();
+    }
+    if (position >= length) return false;
+    block = string_view (data + position, end - position);
+    position = scanned = end;
+    return true;
+}
+
+string_view LineReader::content() {
+    while (inflater && refill()) {}
+    return string_view (data, length);
+}
+
+size_t LineReader::size() const {
+    return length;
+}
+
+size_t LineReader::consumed() const {
+    return dropped + min (position, length);
+}
+
+bool LineReader::streaming() const {
+    return inflater != nullptr;
+}
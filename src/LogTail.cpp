@@ -0,0 +1,180 @@
+#include "LogTail.h"
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+using namespace std;
+
+
+namespace {
+
+    constexpr size_t READ_SIZE = 1 << 16;
+
+    constexpr uint32_t FILE_EVENTS = IN_MODIFY | IN_ATTRIB | IN_MOVE_SELF | IN_DELETE_SELF;
+    constexpr uint32_t DIRECTORY_EVENTS = IN_CREATE | IN_MOVED_TO;
+
+}
+
+
+/* ---------- CONSTRUCTORS ---------- */
+
+LogTail::LogTail()
+    : fd(-1), notify(-1), fileWatch(-1), current{0, 0, 0}, readOffset(0), start(0), scanned(0),
+      hasLastLine(false), rotations(0), truncations(0) {}
+
+LogTail::~LogTail() {
+    close();
+}
+
+
+/* ---------- BASIC METHODS ---------- */
+
+bool LogTail::open (const string &file, const TailPosition* resume) {
+    close();
+    path = file;
+    fd = ::open (file.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat info;
+    if (fd < 0 || fstat (fd, &info) != 0) {
+        close();
+        return false;
+    }
+    current = { (uint64_t)info.st_dev, (uint64_t)info.st_ino, 0 };
+    if (resume && resume->device == current.device && resume->inode == current.inode
+        && resume->offset <= (uint64_t)info.st_size && lseek (fd, resume->offset, SEEK_SET) >= 0)
+        current.offset = resume->offset;
+    readOffset = current.offset;
+
+    // watched before the first read, so no change after it goes unnoticed
+    notify = inotify_init1 (IN_NONBLOCK | IN_CLOEXEC);
+    if (notify >= 0) {
+        string directory = filesystem::path (file).parent_path().string();
+        if (inotify_add_watch (notify, directory.empty() ? "." : directory.c_str(), DIRECTORY_EVENTS) < 0) {
+            ::close (notify);
+            notify = -1;
+        }
+        else watchFile();
+    }
+    return true;
+}
+
+void LogTail::close() {
+    if (fd >= 0) ::close (fd);
+    if (notify >= 0) ::close (notify);
+    fd = notify = fileWatch = -1;
+    current = { 0, 0, 0 };
+    readOffset = start = scanned = 0;
+    buffer.clear();
+    hasLastLine = false;
+    rotations = truncations = 0;
+}
+
+void LogTail::watchFile() {
+    if (notify < 0) return;
+    if (fileWatch >= 0) inotify_rm_watch (notify, fileWatch);
+    fileWatch = inotify_add_watch (notify, path.c_str(), FILE_EVENTS);
+}
+
+bool LogTail::readMore() {
+    buffer.erase (0, start);
+    scanned -= start;
+    start = 0;
+    size_t used = buffer.size();
+    buffer.resize (used + READ_SIZE);
+    ssize_t n;
+    while ((n = read (fd, &buffer[used], READ_SIZE)) < 0 && errno == EINTR) {}
+    buffer.resize (used + (n > 0 ? n : 0));
+    if (n <= 0) return false;
+    readOffset += n;
+    return true;
+}
+
+bool LogTail::checkFile() {
+    struct stat info;
+    if (fstat (fd, &info) == 0 && (uint64_t)info.st_size < readOffset) {
+        // truncated in place: what was read is gone, the file starts over
+        lseek (fd, 0, SEEK_SET);
+        buffer.clear();
+        start = scanned = 0;
+        current.offset = readOffset = 0;
+        ++truncations;
+        return true;
+    }
+
+    // rotated: path names another file now (none while the replacement is not created yet)
+    struct stat named;
+    if (stat (path.c_str(), &named) != 0) return false;
+    if ((uint64_t)named.st_dev == current.device && (uint64_t)named.st_ino == current.inode) return false;
+    int replacement = ::open (path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (replacement < 0 || fstat (replacement, &named) != 0) {
+        if (replacement >= 0) ::close (replacement);
+        return false;
+    }
+    if (start < buffer.size()) {
+        lastLine.assign (buffer, start, string::npos);
+        hasLastLine = true;
+    }
+    ::close (fd);
+    fd = replacement;
+    current = { (uint64_t)named.st_dev, (uint64_t)named.st_ino, 0 };
+    readOffset = 0;
+    buffer.clear();
+    start = scanned = 0;
+    watchFile();
+    ++rotations;
+    return true;
+}
+
+bool LogTail::next (string_view &line) {
+    if (fd < 0) return false;
+    if (hasLastLine) {
+        hasLastLine = false;
+        line = lastLine;
+        return true;
+    }
+    while (true) {
+        const char* data = buffer.data();
+        const char* end = (const char*)memchr (data + scanned, '\n', buffer.size() - scanned);
+        if (end) {
+            line = string_view (data + start, end - (data + start));
+            current.offset += end - (data + start) + 1;
+            start = scanned = end - data + 1;
+            return true;
+        }
+        scanned = buffer.size();
+        if (readMore()) continue;
+        if (!checkFile()) return false;
+        if (hasLastLine) return next (line);
+    }
+}
+
+void LogTail::wait (unsigned timeoutMs) {
+    if (notify < 0) {
+        poll (nullptr, 0, min (timeoutMs, POLL_MS));
+        return;
+    }
+    struct pollfd events = { notify, POLLIN, 0 };
+    if (poll (&events, 1, timeoutMs) <= 0) return;
+    // the events themselves do not matter, next() looks at the file again
+    char drained[4096];
+    while (read (notify, drained, sizeof drained) > 0) {}
+}
+
+TailPosition LogTail::position() const {
+    return current;
+}
+
+bool LogTail::polling() const {
+    return notify < 0;
+}
+
+unsigned LogTail::totalRotations() const {
+    return rotations;
+}
+
+unsigned LogTail::totalTruncations() const {
+    return truncations;
+}
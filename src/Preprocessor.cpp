@@ -1,116 +1,516 @@
 #include "Preprocessor.h"
+#include "LineReader.h"
+#include "TaskPool.h"
 #include <iostream>
 #include <fstream>
 #include <string>
 #include <unordered_set>
-#include <regex>
 #include <cctype>
+#include <cstdio>
+#include <algorithm>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define PREPROCESSOR_X86 1
+#endif
+
+
+namespace {
+
+    struct CleanState {
+        char* begin;
+        char* p;      // next output byte
+        bool space;   // a space is held back
+    };
+
+    // Spaces are held back until the next kept byte, which collapses runs and drops trailing ones;
+    // a space right after a line edge is never held. No delimiter is written after another one.
+    inline void cleanByte(const CharAction* actions, char c, CleanState& s) {
+        switch (actions[(unsigned char)c]) {
+            case CHAR_KEEP:
+                if (s.space) *s.p++ = ' ';
+                s.space = false;
+                *s.p++ = c;
+                break;
+            case CHAR_LOWER:
+                if (s.space) *s.p++ = ' ';
+                s.space = false;
+                *s.p++ = c + ('a' - 'A');
+                break;
+            case CHAR_DROP:
+                break;
+            case CHAR_DELIMITER:
+                if (s.space) *s.p++ = ' ';
+                s.space = false;
+                if (s.p == s.begin || s.p[-1] != '\n') *s.p++ = '\n';
+                break;
+            case CHAR_SPACE:
+                if (s.p != s.begin && s.p[-1] != '\n') s.space = true;
+                break;
+        }
+    }
+
+
+    /* ---------- SIMD kernels ---------- */
+
+    // A block is copied at once (lowercased) when it has no dropped or delimiter byte and its
+    // spaces stay as they are: no two in a row, none at a line edge. Any other block goes through
+    // cleanByte. Special bytes are found with two nibble lookups: specialLow[hi >= 8][lo] has bit
+    // (hi & 7) set for every special byte hi:lo.
+
+#ifdef PREPROCESSOR_X86
+    __attribute__((target("avx2")))
+    size_t cleanBlocksAVX2 (const CharAction* actions, const unsigned char (*specialLow)[16], bool toLower,
+                            const char* in, size_t n, CleanState& s) {
+        const __m256i lowA = _mm256_broadcastsi128_si256 (_mm_loadu_si128 ((const __m128i*)specialLow[0]));
+        const __m256i lowB = _mm256_broadcastsi128_si256 (_mm_loadu_si128 ((const __m128i*)specialLow[1]));
+        const __m256i rowBit = _mm256_setr_epi8 (1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128,
+                                                 1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+        const __m256i nibble = _mm256_set1_epi8 (0x0F);
+        const __m256i space = _mm256_set1_epi8 (' ');
+        const __m256i beforeA = _mm256_set1_epi8 ('A' - 1);
+        const __m256i afterZ = _mm256_set1_epi8 ('Z' + 1);
+        const __m256i caseBit = _mm256_set1_epi8 (toLower ? 0x20 : 0);
+
+        size_t i = 0;
+        for (; i + 32 <= n; i += 32) {
+            __m256i c = _mm256_loadu_si256 ((const __m256i*)(in + i));
+            __m256i lo = _mm256_and_si256 (c, nibble);
+            __m256i hi = _mm256_and_si256 (_mm256_srli_epi16 (c, 4), nibble);
+            __m256i rows = _mm256_blendv_epi8 (_mm256_shuffle_epi8 (lowA, lo), _mm256_shuffle_epi8 (lowB, lo), c);
+            uint32_t spaces = (uint32_t)_mm256_movemask_epi8 (_mm256_cmpeq_epi8 (c, space));
+            bool edge = s.space || s.p == s.begin || s.p[-1] == '\n';
+
+            if (!_mm256_testz_si256 (rows, _mm256_shuffle_epi8 (rowBit, hi))
+                || (spaces & (spaces << 1)) || ((spaces & 1) && edge)) {
+                for (size_t j = i; j < i + 32; ++j) cleanByte (actions, in[j], s);
+                continue;
+            }
+
+            __m256i upper = _mm256_and_si256 (_mm256_cmpgt_epi8 (c, beforeA), _mm256_cmpgt_epi8 (afterZ, c));
+            c = _mm256_or_si256 (c, _mm256_and_si256 (upper, caseBit));
+            if (s.space) *s.p++ = ' ';
+            _mm256_storeu_si256 ((__m256i*)s.p, c);
+            s.space = spaces >> 31;
+            s.p += 32 - s.space;
+        }
+        return i;
+    }
+
+    __attribute__((target("sse4.2")))
+    size_t cleanBlocksSSE42 (const CharAction* actions, const unsigned char (*specialLow)[16], bool toLower,
+                             const char* in, size_t n, CleanState& s) {
+        const __m128i lowA = _mm_loadu_si128 ((const __m128i*)specialLow[0]);
+        const __m128i lowB = _mm_loadu_si128 ((const __m128i*)specialLow[1]);
+        const __m128i rowBit = _mm_setr_epi8 (1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+        const __m128i nibble = _mm_set1_epi8 (0x0F);
+        const __m128i space = _mm_set1_epi8 (' ');
+        const __m128i beforeA = _mm_set1_epi8 ('A' - 1);
+        const __m128i afterZ = _mm_set1_epi8 ('Z' + 1);
+        const __m128i caseBit = _mm_set1_epi8 (toLower ? 0x20 : 0);
+
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16) {
+            __m128i c = _mm_loadu_si128 ((const __m128i*)(in + i));
+            __m128i lo = _mm_and_si128 (c, nibble);
+            __m128i hi = _mm_and_si128 (_mm_srli_epi16 (c, 4), nibble);
+            __m128i rows = _mm_blendv_epi8 (_mm_shuffle_epi8 (lowA, lo), _mm_shuffle_epi8 (lowB, lo), c);
+            uint32_t spaces = (uint32_t)_mm_movemask_epi8 (_mm_cmpeq_epi8 (c, space));
+            bool edge = s.space || s.p == s.begin || s.p[-1] == '\n';
+
+            if (!_mm_testz_si128 (rows, _mm_shuffle_epi8 (rowBit, hi))
+                || (spaces & (spaces << 1)) || ((spaces & 1) && edge)) {
+                for (size_t j = i; j < i + 16; ++j) cleanByte (actions, in[j], s);
+                continue;
+            }
+
+            __m128i upper = _mm_and_si128 (_mm_cmpgt_epi8 (c, beforeA), _mm_cmpgt_epi8 (afterZ, c));
+            c = _mm_or_si128 (c, _mm_and_si128 (upper, caseBit));
+            if (s.space) *s.p++ = ' ';
+            _mm_storeu_si128 ((__m128i*)s.p, c);
+            s.space = spaces >> 15;
+            s.p += 16 - s.space;
+        }
+        return i;
+    }
+#endif
+
+    // Captures of every match of re in line (the whole match when there are no groups); each
+    // search starts where the last match ended, as regex_search on the rest of the line
+    template <typename Emit>
+    void extractMatches(Regex& re, std::string_view line, std::vector<ptrdiff_t>& spans, Emit emit) {
+        std::string_view rest = line;
+        while (re.search(rest, spans)) {
+
+            for (size_t i = spans.size() > 2 ? 1 : 0; i < spans.size() / 2; i++) {
+                if (spans[2 * i + 1] > spans[2 * i]) emit(rest.substr(spans[2 * i], spans[2 * i + 1] - spans[2 * i]));
+            }
+
+            size_t end = spans[1];
+            // an empty match would be found again at the same place
+            if (spans[0] == spans[1]) {
+                if (end == rest.size()) break;
+                ++end;
+            }
+            rest.remove_prefix(end);
+        }
+    }
+
+    // getline over a stream, with the next() of LineReader
+    struct StreamLines {
+        std::istream& in;
+        std::string line;
+
+        bool next(std::string_view& view) {
+            if (!std::getline(in, line)) return false;
+            view = line;
+            return true;
+        }
+    };
+
+    template <typename Lines>
+    void filterLines(Regex& re, Lines& lines, const Preprocessor::LineSink& sink) {
+        std::string_view line;
+        std::vector<ptrdiff_t> spans;
+        while (lines.next(line)) extractMatches(re, line, spans, sink);
+    }
+
+    template <typename Lines>
+    void filterLines(RegexSet& set, Lines& lines, const Preprocessor::PatternSink& sink) {
+        std::string_view line;
+        std::vector<ptrdiff_t> spans;
+        std::vector<size_t> matching;
+        while (lines.next(line)) {
+            // one pass over the line finds the patterns worth searching
+            set.matching(line, matching);
+            for (size_t k : matching) {
+                extractMatches(set.pattern(k), line, spans, [&](std::string_view capture) { sink(k, capture); });
+            }
+        }
+    }
+
+}
+
 
 Preprocessor::Preprocessor(bool toLower)
-    : toLower(toLower) {
+    : toLower(toLower), regexEngine(REGEX_DFA), inputBytes(0) {
+    for (int c = 0; c < 256; ++c) {
+        actions[c] = (toLower && c >= 'A' && c <= 'Z') ? CHAR_LOWER : CHAR_KEEP;
+    }
+    actions[(unsigned char)'\n'] = CHAR_DELIMITER;
+    actions[(unsigned char)' '] = CHAR_SPACE;
+    compileLookup();
 }
 
-void Preprocessor::setIgnoredCharacters(const std::string& chars) {
-    for (char c : chars) {
-        ignoredChars.insert(toLower ? (char)std::tolower(c) : c);
+// ASCII lowercasing only, independent of the locale
+unsigned char Preprocessor::fold(unsigned char c) const {
+    return (toLower && c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+// Every byte that cleans to the same character as c gets the action; ignoring wins over delimiting
+void Preprocessor::setAction(char c, CharAction action) {
+    unsigned char target = fold(c);
+    for (int b = 0; b < 256; ++b) {
+        if (fold(b) != target || actions[b] == CHAR_DROP) continue;
+        actions[b] = action;
     }
 }
 
-void Preprocessor::setDelimiters(const std::string& chars) {
-    for (char c : chars) {
-        delimiters.insert(toLower ? (char)std::tolower(c) : c);
+void Preprocessor::compileLookup() {
+    for (int b = 0; b < 256; ++b) {
+        unsigned char hi = b >> 4, lo = b & 0x0F;
+        unsigned char bit = 1 << (hi & 7);
+        if (actions[b] == CHAR_DROP || actions[b] == CHAR_DELIMITER) specialLow[hi >> 3][lo] |= bit;
+        else specialLow[hi >> 3][lo] &= ~bit;
     }
 }
 
+void Preprocessor::setIgnoredCharacters(const std::string& chars) {
+    for (char c : chars) setAction(c, CHAR_DROP);
+    compileLookup();
+}
 
-std::string Preprocessor::normalizeWhitespace(const std::string& s) const {
-    std::string out;
-    bool lastSpace = false;
-    for (char c : s) {
-        if (c == ' ') {
-            if (!lastSpace) out += ' ';
-            lastSpace = true;
-        } else {
-            out += c;
-            lastSpace = false;
-        }
-    }
+void Preprocessor::setDelimiters(const std::string& chars) {
+    for (char c : chars) setAction(c, CHAR_DELIMITER);
+    compileLookup();
+}
 
-    size_t start = out.find_first_not_of(' ');
-    if (start == std::string::npos) return "";
-    out = out.substr(start);
+void Preprocessor::setRegexEngine(RegexEngine engine) {
+    regexEngine = engine;
+}
 
-    // Xóa toàn bộ space ở cuối
-    size_t end = out.find_last_not_of(' ');
-    out = out.substr(0, end + 1);
-    return out;
+SIMDLevel Preprocessor::simdLevel() {
+#ifdef PREPROCESSOR_X86
+    static const SIMDLevel level = __builtin_cpu_supports ("avx2") ? SIMD_AVX2
+                                 : __builtin_cpu_supports ("sse4.2") ? SIMD_SSE42 : SIMD_NONE;
+    return level;
+#else
+    return SIMD_NONE;
+#endif
 }
 
+
 std::string Preprocessor::cleanLine(const std::string& line) const {
     std::string result;
+    cleanLine(line, result);
+    return result;
+}
+
+void Preprocessor::cleanLine(std::string_view line, std::string& out) const {
+    cleanLine(line, out, simdLevel());
+}
+
+void Preprocessor::cleanLine(std::string_view line, std::string& out, SIMDLevel level) const {
+    out.resize(line.size());
+    CleanState s = { out.data(), out.data(), false };
+
+    size_t i = 0;
+#ifdef PREPROCESSOR_X86
+    if (level >= SIMD_AVX2 && simdLevel() >= SIMD_AVX2)
+        i = cleanBlocksAVX2 (actions, specialLow, toLower, line.data(), line.size(), s);
+    else if (level >= SIMD_SSE42 && simdLevel() >= SIMD_SSE42)
+        i = cleanBlocksSSE42 (actions, specialLow, toLower, line.data(), line.size(), s);
+#endif
+    for (; i < line.size(); ++i) cleanByte(actions, line[i], s);
+    out.resize(s.p - s.begin);
+}
+
+std::vector<Symbol> Preprocessor::tokenize(std::string_view line, SymbolTable& table) const {
+    std::vector<Symbol> tokens;
+    tokenize(line, table, tokens);
+    return tokens;
+}
 
-    for (char c : line) {
-        char processed = toLower ? (char)std::tolower(c) : c;
+void Preprocessor::tokenize(std::string_view line, SymbolTable& table, std::vector<Symbol>& tokens) const {
+    tokens.clear();
+    size_t i = 0;
+    for (std::string_view token; !(token = SymbolTable::nextToken(line, i)).empty(); ) {
+        tokens.push_back(table.intern(token));
+    }
+}
 
-        if (ignoredChars.count(processed)) continue;
-        if (delimiters.count(processed)) processed = '\n';
+void Preprocessor::processStream(std::istream& in, const LineSink& sink) const {
+    std::string line, cleaned;
+    while (std::getline(in, line)) {
+        cleanLine(line, cleaned);
+        if (!cleaned.empty()) sink(cleaned);
+    }
+}
 
-        if (processed == '\n') {
-            if (!result.empty() && result.back() == '\n') continue;
+bool Preprocessor::processFile(const std::string& inputFile, const LineSink& sink) const {
+    LineReader reader;
+    if (!reader.open(inputFile)) {
+        return false;
+    }
+    std::string_view line;
+    std::string cleaned;
+    while (reader.next(line)) {
+        cleanLine(line, cleaned);
+        if (!cleaned.empty()) sink(cleaned);
+    }
+    inputBytes = reader.consumed();
+    return true;
+}
+
+size_t Preprocessor::bytesRead() const {
+    return inputBytes;
+}
+
+bool Preprocessor::mineTemplates(const std::string& inputFile, TemplateMiner& miner, const TemplateSink& sink) const {
+    // a cleaned line holds several lines when delimiters split it
+    return processFile(inputFile, [&](std::string_view cleaned) {
+        size_t begin = 0;
+        while (begin < cleaned.size()) {
+            size_t end = std::min(cleaned.find('\n', begin), cleaned.size());
+            if (end > begin) {
+                std::string_view line = cleaned.substr(begin, end - begin);
+                sink(miner.add(line), line);
+            }
+            begin = end + 1;
         }
+    });
+}
 
-    if (processed == ' ' && (result.empty() || result.back() == '\n')) {
-        continue;
+bool Preprocessor::writeTemplates(const std::string& inputFile, TemplateMiner& miner, const std::string& spoolFile,
+                                  const LineSink& sink, const ParamSink& params) const {
+    // spool record: the template id, then with params the line's length and bytes
+    std::ofstream spool(spoolFile, std::ios::trunc | std::ios::binary);
+    if (!spool.is_open()) {
+        std::cerr << "[ERROR] Cannot open spool file at '" << spoolFile << "'" << std::endl;
+        return false;
     }
-    
-        result += processed;
+    bool readable = mineTemplates(inputFile, miner, [&](uint32_t id, std::string_view line) {
+        spool.write((const char*)&id, sizeof id);
+        if (!params) return;
+        uint32_t size = line.size();
+        spool.write((const char*)&size, sizeof size);
+        spool.write(line.data(), size);
+    });
+    spool.close();
+    bool ok = readable && !spool.fail();
+
+    if (ok) {
+        std::vector<std::string> templates(miner.size());
+        for (uint32_t id = 0; id < templates.size(); ++id) templates[id] = miner.templateOf(id);
+        std::ifstream replay(spoolFile, std::ios::binary);
+        std::string line;
+        std::vector<std::string_view> values;
+        uint32_t id, size;
+        while (replay.read((char*)&id, sizeof id)) {
+            if (id >= templates.size()) break;
+            sink(templates[id]);
+            if (!params) continue;
+            if (!replay.read((char*)&size, sizeof size)) break;
+            line.resize(size);
+            if (!replay.read(&line[0], size)) break;
+            miner.parameters(line, id, values);
+            params(id, values);
+        }
+        ok = replay.eof();
     }
+    std::remove(spoolFile.c_str());
+    return ok;
+}
 
-    result = normalizeWhitespace(result);
+LineCounter::LineCounter() : totalLines(0) {}
 
-    return result;
+void LineCounter::add(std::string_view line, unsigned count) {
+    Symbol id = lines.intern(line);
+    if (id == counts.size()) counts.push_back(0);
+    counts[id] += count;
+    totalLines += count;
+}
+
+size_t LineCounter::size() const {
+    return counts.size();
+}
+
+size_t LineCounter::total() const {
+    return totalLines;
+}
+
+void LineCounter::forEach(const std::function<void(std::string_view, unsigned)>& sink) const {
+    for (Symbol id = 0; id < counts.size(); ++id) sink(lines.lookup(id), counts[id]);
+}
+
+void LineCounter::write(std::ostream& out) const {
+    forEach([&](std::string_view line, unsigned count) { out << line << '\t' << count << '\n'; });
 }
 
 std::vector<std::string> Preprocessor::processFile(
     const std::string& inputFile,
     const std::string& outputFile
 ) {
-
-    std::ifstream fin(inputFile);
-    if (!fin.is_open()) {
-        return {};
-    }
-
     std::ofstream fout;
     if (!outputFile.empty()) {
         fout.open(outputFile);
         if (!fout.is_open()) {
-            fin.close();
             return {};
         }
     }
 
     std::vector<std::string> sequences;
-    std::string line;
-    int lineCount = 0;
+    processFile(inputFile, [&](std::string_view cleaned) {
+        sequences.emplace_back(cleaned);
+        if (fout.is_open()) {
+            fout << cleaned << '\n';
+        }
+    });
+    return sequences;
+}
 
-    while (std::getline(fin, line)) {
-        line = cleanLine(line);
-        if (line.empty()) continue;
+bool Preprocessor::processFileParallel(
+    const std::string& inputFile,
+    const std::string& outputFile,
+    unsigned threads
+) {
+    // chunks of a few MB; one round cleans 4 chunks per worker and writes them before the next,
+    // which bounds memory to the round
+    const size_t CHUNK_SIZE = 4 << 20;
 
-        ++lineCount;
-        sequences.push_back(line);
+    LineReader reader;
+    if (!reader.open(inputFile)) {
+        return false;
+    }
+    std::ofstream fout(outputFile, std::ios::binary);
+    if (!fout.is_open()) {
+        return false;
+    }
 
-        if (fout.is_open()) {
-            fout << line << '\n';
+    TaskPool pool(threads);
+    size_t round = std::max<size_t>(1, (size_t)pool.size() * 4);
+    std::vector<std::string_view> chunks;
+    std::vector<std::string> copies(round), cleanedChunks(round);
+    std::string_view block;
+
+    while (true) {
+        // views into a decompressed stream only last until the next block: those are copied
+        chunks.clear();
+        while (chunks.size() < round && reader.nextBlock(CHUNK_SIZE, block)) {
+            if (reader.streaming()) block = copies[chunks.size()].assign(block);
+            chunks.push_back(block);
         }
+        if (chunks.empty()) break;
+
+        pool.run(chunks.size(), [&](size_t t, unsigned) {
+            std::string_view chunk = chunks[t];
+            std::string& out = cleanedChunks[t];
+            std::string cleaned;
+            out.clear();
+            out.reserve(chunk.size());
+            size_t i = 0;
+            while (i < chunk.size()) {
+                size_t j = chunk.find('\n', i);
+                if (j == std::string_view::npos) j = chunk.size();
+                cleanLine(chunk.substr(i, j - i), cleaned);
+                if (!cleaned.empty()) out.append(cleaned).push_back('\n');
+                i = j + 1;
+            }
+        });
+        for (size_t t = 0; t < chunks.size(); ++t) fout.write(cleanedChunks[t].data(), cleanedChunks[t].size());
     }
 
-    fin.close();
-    if (fout.is_open()) {
-        fout.close();
+    inputBytes = reader.consumed();
+    fout.close();
+    return !fout.fail();
+}
+
+bool Preprocessor::filterByRegex(std::istream& in, const std::string& pattern, const LineSink& sink) const {
+    Regex re;
+    if (!re.compile(pattern, regexEngine)) {
+        return false;
     }
-    return sequences;
+    StreamLines lines{in, std::string()};
+    filterLines(re, lines, sink);
+    return true;
+}
+
+bool Preprocessor::filterByRegex(LineReader& reader, const std::string& pattern, const LineSink& sink) const {
+    Regex re;
+    if (!re.compile(pattern, regexEngine)) {
+        return false;
+    }
+    filterLines(re, reader, sink);
+    return true;
+}
+
+bool Preprocessor::filterByRegex(std::istream& in, const std::vector<std::string>& patterns, const PatternSink& sink) const {
+    RegexSet set;
+    if (!set.compile(patterns, regexEngine)) {
+        return false;
+    }
+    StreamLines lines{in, std::string()};
+    filterLines(set, lines, sink);
+    return true;
+}
+
+bool Preprocessor::filterByRegex(LineReader& reader, const std::vector<std::string>& patterns, const PatternSink& sink) const {
+    RegexSet set;
+    if (!set.compile(patterns, regexEngine)) {
+        return false;
+    }
+    filterLines(set, reader, sink);
+    return true;
 }
 
 std::vector<std::string> Preprocessor::filterByRegex(
@@ -119,61 +519,36 @@ std::vector<std::string> Preprocessor::filterByRegex(
 ) {
     std::vector<std::string> results;
 
-    std::ifstream fin(inputFile);
-    if (!fin.is_open()) {
+    LineReader reader;
+    if (!reader.open(inputFile)) {
         return results;
     }
+    filterByRegex(reader, pattern, [&](std::string_view capture) { results.emplace_back(capture); });
+    return results;
+}
 
-    std::regex re;
-    try {
-        re.assign(pattern);
-    } catch (const std::regex_error& e) {
-        return results;
-    }
-    
-    std::string line;
-
-    while (std::getline(fin, line)) {
-        std::smatch match;
-
-        auto it = line.cbegin();
-        while (std::regex_search(it, line.cend(), match, re)) {
-
-            if (match.size() > 1) {
-                for (size_t i = 1; i < match.size(); i++) {
-                    std::string cap = match[i].str();
-                    if (!cap.empty()) {
-                        results.push_back(cap);
-                    }
-                }
-            } else {
-                std::string full = match[0].str();
-                if (!full.empty()) {
-                    results.push_back(full);
-                }
-            }
-
-            it = match.suffix().first;
-        }
+void Preprocessor::writeCollected(std::ostream& out, std::string_view s) const {
+    if (!toLower) {
+        out << s << '\n';
+        return;
     }
+    for (char c : s) out.put(fold(c));
+    out.put('\n');
+}
 
-    fin.close();
-    return results;
+void Preprocessor::foldCollected(std::string_view s, std::string& out) const {
+    out.assign(s);
+    if (!toLower) return;
+    for (char& c : out) c = fold(c);
 }
 
-void Preprocessor::exportCollected(const std::string& outputFile, vector<string> collected) {
+void Preprocessor::exportCollected(const std::string& outputFile, const vector<string>& collected) const {
     
     ofstream fout(outputFile, ios::trunc | ios::binary);
     if (!fout.is_open()) return;
 
-
-    for (std::string s : collected) {
-        if (toLower) {
-            for (char& c : s) c = std::tolower(c);
-        }
-        fout << s << "\n";
-    }
+    for (const std::string& s : collected) writeCollected(fout, s);
 
     fout.close();
     return ;
-}
\ No newline at end of file
+}
@@ -0,0 +1,164 @@
+#include "QuantileSketch.h"
+#include <algorithm>
+#include <cmath>
+#include <utility>
+using namespace std;
+
+
+/* ---------- CONSTRUCTORS ---------- */
+
+QuantileSketch::QuantileSketch (size_t exactLimit, unsigned k) :
+    exactLimit(exactLimit),
+    k(max(k, 8u)),
+    countValues(0),
+    exact(true) {}
+
+
+/* ---------- HELPERS ---------- */
+
+// KLL capacities shrink geometrically (factor 2/3) from the top level down
+void QuantileSketch::setLevels (size_t count) {
+    levels.resize (count);
+    offsets.resize (count, 0);
+    capacities.resize (count);
+    for (size_t h = 0; h < count; ++h)
+        capacities[h] = max<size_t> (2, (size_t)ceil (k * pow (2.0 / 3.0, (double)(count - 1 - h))));
+}
+
+size_t QuantileSketch::retained() const {
+    size_t total = 0;
+    for (const vector<double> &level : levels) total += level.size();
+    return total;
+}
+
+void QuantileSketch::toSketch() {
+    exact = false;
+    setLevels (1);
+    levels[0].swap (values);
+    compress();
+}
+
+// Compact the lowest overfull level until the sketch fits its total capacity
+void QuantileSketch::compress() {
+    for (;;) {
+        size_t total = 0, budget = 0;
+        for (size_t h = 0; h < levels.size(); ++h) {
+            total += levels[h].size();
+            budget += capacities[h];
+        }
+        if (total <= budget) return;
+
+        for (size_t h = 0; h < levels.size(); ++h) {
+            if (levels[h].size() >= capacities[h]) {
+                compact (h);
+                break;
+            }
+        }
+    }
+}
+
+// Sort a level and promote every other item to the level above (weights double)
+void QuantileSketch::compact (size_t level) {
+    if (level + 1 == levels.size()) setLevels (levels.size() + 1);
+    vector<double> &items = levels[level];
+    sort (items.begin(), items.end());
+
+    // an odd item out stays behind
+    double leftover = 0;
+    bool odd = items.size() % 2;
+    if (odd) {
+        leftover = items.back();
+        items.pop_back();
+    }
+
+    vector<double> &above = levels[level + 1];
+    for (size_t i = offsets[level]; i < items.size(); i += 2) above.push_back (items[i]);
+    offsets[level] ^= 1;
+
+    items.clear();
+    if (odd) items.push_back (leftover);
+}
+
+
+/* ---------- BASIC METHODS ---------- */
+
+void QuantileSketch::add (double value) {
+    ++countValues;
+    if (exact) {
+        values.push_back (value);
+        if (values.size() > exactLimit) toSketch();
+        return;
+    }
+    levels[0].push_back (value);
+    if (levels[0].size() >= capacities[0]) compress();
+}
+
+void QuantileSketch::merge (const QuantileSketch &other) {
+    countValues += other.countValues;
+
+    if (exact && other.exact) {
+        values.insert (values.end(), other.values.begin(), other.values.end());
+        if (values.size() > exactLimit) toSketch();
+        return;
+    }
+    if (exact) toSketch();
+
+    if (other.exact) {
+        levels[0].insert (levels[0].end(), other.values.begin(), other.values.end());
+    }
+    else {
+        if (other.levels.size() > levels.size()) setLevels (other.levels.size());
+        for (size_t h = 0; h < other.levels.size(); ++h)
+            levels[h].insert (levels[h].end(), other.levels[h].begin(), other.levels[h].end());
+    }
+    compress();
+}
+
+void QuantileSketch::clear() {
+    countValues = 0;
+    exact = true;
+    values.clear();
+    levels.clear();
+    offsets.clear();
+    capacities.clear();
+}
+
+double QuantileSketch::quantile (double percentile) {
+    if (countValues == 0) return 0;
+    size_t rank = (size_t)((percentile / 100.0) * countValues);
+    if (rank >= countValues) rank = countValues - 1;
+
+    if (exact) {
+        nth_element (values.begin(), values.begin() + rank, values.end());
+        return values[rank];
+    }
+
+    // weighted items in value order: the answer is the first whose cumulative weight passes rank
+    vector<pair<double, size_t>> items;
+    items.reserve (retained());
+    for (size_t h = 0; h < levels.size(); ++h)
+        for (double v : levels[h]) items.emplace_back (v, (size_t)1 << h);
+    sort (items.begin(), items.end());
+
+    size_t cumulative = 0;
+    for (const pair<double, size_t> &item : items) {
+        cumulative += item.second;
+        if (cumulative > rank) return item.first;
+    }
+    return items.back().first;
+}
+
+
+/* ---------- STATISTICAL METHODS ---------- */
+
+size_t QuantileSketch::size() const {
+    return countValues;
+}
+
+size_t QuantileSketch::limit() const {
+    return exactLimit;
+}
+
+bool QuantileSketch::isExact() const {
+    return exact;
+}
@@ -0,0 +1,944 @@
+#include "Regex.h"
+#include <algorithm>
+#include <bitset>
+#include <unordered_map>
+using namespace std;
+
+
+namespace {
+
+    enum Op : uint8_t {
+        OP_CHAR,    // consume a byte of sets[x]
+        OP_SPLIT,   // continue at x, then (lower priority) at y
+        OP_JMP,     // continue at x
+        OP_SAVE,    // record the position in span slot x
+        OP_ASSERT,  // continue if assertion x holds
+        OP_MATCH
+    };
+
+    enum Assertion : uint8_t {
+        AT_BEGIN,           // ^
+        AT_END,             // $
+        WORD_BOUNDARY,      // \b
+        NOT_WORD_BOUNDARY   // \B
+    };
+
+    struct Inst {
+        Op op;
+        int x;
+        int y;
+    };
+
+    using ByteSet = bitset<256>;
+
+    // Byte class of \w, as std::regex sees it in the "C" locale
+    inline bool isWordByte (unsigned char c) {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+    }
+
+    ByteSet wordSet() {
+        ByteSet s;
+        for (int c = 0; c < 256; c++) if (isWordByte (c)) s.set (c);
+        return s;
+    }
+
+    ByteSet range (unsigned char low, unsigned char high) {
+        ByteSet s;
+        for (int c = low; c <= high; c++) s.set (c);
+        return s;
+    }
+
+
+    /* ---------- PARSER ---------- */
+
+    struct Node {
+        enum Type : uint8_t { SET, EMPTY, CONCAT, ALTERNATE, REPEAT, GROUP, ASSERT } type;
+        ByteSet set;             // SET
+        vector<int> children;    // CONCAT, ALTERNATE; REPEAT and GROUP have one
+        int min = 0, max = 0;    // REPEAT, max < 0: unbounded
+        bool greedy = true;      // REPEAT
+        int group = 0;           // GROUP
+        Assertion assertion = AT_BEGIN; // ASSERT
+    };
+
+    // Recursive descent over the supported subset; supported turns false on anything else,
+    // which leaves the pattern to std::regex (including the ones it rejects)
+    class Parser {
+
+        const string &p;
+        size_t i = 0;
+
+        static constexpr int MAX_REPEAT = 1000;
+
+        int add (Node::Type type) {
+            nodes.push_back (Node());
+            nodes.back().type = type;
+            return nodes.size() - 1;
+        }
+
+        int unsupported() {
+            supported = false;
+            return add (Node::EMPTY);
+        }
+
+        // \d \w \s and negations; false for any other letter
+        bool classEscape (char c, ByteSet &set) {
+            switch (c) {
+                case 'd': set = range ('0', '9'); return true;
+                case 'D': set = ~range ('0', '9'); return true;
+                case 'w': set = wordSet(); return true;
+                case 'W': set = ~wordSet(); return true;
+                case 's': case 'S':
+                    set.reset();
+                    for (char space : string (" \t\n\v\f\r")) set.set ((unsigned char)space);
+                    if (c == 'S') set.flip();
+                    return true;
+            }
+            return false;
+        }
+
+        // Escaped single byte: control letters and punctuation; -1 for unsupported escapes
+        int byteEscape (char c) {
+            switch (c) {
+                case 'n': return '\n';
+                case 't': return '\t';
+                case 'r': return '\r';
+                case 'f': return '\f';
+                case 'v': return '\v';
+            }
+            unsigned char u = c;
+            if (u >= 0x80 || isWordByte (u)) return -1;
+            return u;
+        }
+
+        int characterClass() {
+            // after '['
+            bool negate = i < p.size() && p[i] == '^';
+            if (negate) ++i;
+            if (i < p.size() && p[i] == ']') return unsupported(); // "[]" and "[^]"
+
+            ByteSet set;
+            while (i < p.size() && p[i] != ']') {
+                if (p[i] == '[' && i + 1 < p.size() && (p[i + 1] == ':' || p[i + 1] == '=' || p[i + 1] == '.')) return unsupported();
+
+                int low;
+                if (p[i] == '\\') {
+                    if (++i >= p.size()) return unsupported();
+                    ByteSet escaped;
+                    if (classEscape (p[i], escaped)) {
+                        set |= escaped;
+                        ++i;
+                        if (i < p.size() && p[i] == '-' && i + 1 < p.size() && p[i + 1] != ']') return unsupported();
+                        continue;
+                    }
+                    if ((low = byteEscape (p[i])) < 0) return unsupported();
+                }
+                else low = (unsigned char)p[i];
+                ++i;
+
+                if (i + 1 < p.size() && p[i] == '-' && p[i + 1] != ']') {
+                    ++i;
+                    int high;
+                    if (p[i] == '\\') {
+                        if (++i >= p.size() || (high = byteEscape (p[i])) < 0) return unsupported();
+                    }
+                    else high = (unsigned char)p[i];
+                    ++i;
+                    // std::regex compares plain chars: ranges stay within ASCII to agree on signedness
+                    if (low > high || high >= 0x80) return unsupported();
+                    set |= range (low, high);
+                }
+                else set.set (low);
+            }
+            if (i >= p.size()) return unsupported();
+            ++i;
+
+            int node = add (Node::SET);
+            nodes[node].set = negate ? ~set : set;
+            return node;
+        }
+
+        int atom() {
+            char c = p[i++];
+            switch (c) {
+                case '(': {
+                    int group = 0;
+                    if (i < p.size() && p[i] == '?') {
+                        if (i + 1 >= p.size() || p[i + 1] != ':') return unsupported();
+                        i += 2;
+                    }
+                    else group = ++groups;
+                    int child = alternation();
+                    if (i >= p.size() || p[i] != ')') return unsupported();
+                    ++i;
+                    if (!group) return child;
+                    int node = add (Node::GROUP);
+                    nodes[node].group = group;
+                    nodes[node].children.push_back (child);
+                    return node;
+                }
+                case '[':
+                    return characterClass();
+                case '.': {
+                    int node = add (Node::SET);
+                    nodes[node].set.set();
+                    nodes[node].set.reset ('\n');
+                    nodes[node].set.reset ('\r');
+                    return node;
+                }
+                case '^': case '$': {
+                    int node = add (Node::ASSERT);
+                    nodes[node].assertion = c == '^' ? AT_BEGIN : AT_END;
+                    return node;
+                }
+                case '\\': {
+                    if (i >= p.size()) return unsupported();
+                    char e = p[i++];
+                    if (e == 'b' || e == 'B') {
+                        int node = add (Node::ASSERT);
+                        nodes[node].assertion = e == 'b' ? WORD_BOUNDARY : NOT_WORD_BOUNDARY;
+                        return node;
+                    }
+                    int node = add (Node::SET);
+                    if (classEscape (e, nodes[node].set)) return node;
+                    int byte = byteEscape (e);
+                    if (byte < 0) return unsupported();
+                    nodes[node].set.set (byte);
+                    return node;
+                }
+                case '*': case '+': case '?': case '{': case '}': case ']': case ')': case '|':
+                    return unsupported();
+            }
+            int node = add (Node::SET);
+            nodes[node].set.set ((unsigned char)c);
+            return node;
+        }
+
+        bool number (int &value) {
+            size_t begin = i;
+            value = 0;
+            while (i < p.size() && p[i] >= '0' && p[i] <= '9' && value <= MAX_REPEAT) value = value * 10 + (p[i++] - '0');
+            return i > begin;
+        }
+
+        // Quantifier following an atom, if any
+        int quantified (int node) {
+            if (i >= p.size() || (p[i] != '*' && p[i] != '+' && p[i] != '?' && p[i] != '{')) return node;
+            int min, max;
+            switch (p[i++]) {
+                case '*': min = 0; max = -1; break;
+                case '+': min = 1; max = -1; break;
+                case '?': min = 0; max = 1; break;
+                default:
+                    if (!number (min)) return unsupported();
+                    max = min;
+                    if (i < p.size() && p[i] == ',') {
+                        ++i;
+                        if (!number (max)) max = -1;
+                    }
+                    if (i >= p.size() || p[i] != '}') return unsupported();
+                    ++i;
+                    if (min > MAX_REPEAT || max > MAX_REPEAT || (max >= 0 && max < min)) return unsupported();
+            }
+            bool greedy = true;
+            if (i < p.size() && p[i] == '?') {
+                greedy = false;
+                ++i;
+            }
+            if (nodes[node].type == Node::ASSERT) return unsupported();
+            // std::regex and the Pike VM disagree on what an empty iteration captures
+            if (max != 1 && max != 0 && nullable (node)) return unsupported();
+
+            int repeat = add (Node::REPEAT);
+            nodes[repeat].min = min;
+            nodes[repeat].max = max;
+            nodes[repeat].greedy = greedy;
+            nodes[repeat].children.push_back (node);
+            return repeat;
+        }
+
+        int concatenation() {
+            int node = add (Node::CONCAT);
+            while (i < p.size() && p[i] != '|' && p[i] != ')') {
+                int item = quantified (atom());
+                nodes[node].children.push_back (item);
+            }
+            return nodes[node].children.size() == 1 ? nodes[node].children[0] : node;
+        }
+
+        int alternation() {
+            int first = concatenation();
+            if (i >= p.size() || p[i] != '|') return first;
+            int node = add (Node::ALTERNATE);
+            nodes[node].children.push_back (first);
+            while (i < p.size() && p[i] == '|') {
+                ++i;
+                int next = concatenation();
+                nodes[node].children.push_back (next);
+            }
+            return node;
+        }
+
+
+        public:
+
+        vector<Node> nodes;
+        int groups = 0;
+        bool supported = true;
+
+        Parser (const string &pattern) : p (pattern) {}
+
+        int parse() {
+            int root = alternation();
+            if (i != p.size()) supported = false;
+            return root;
+        }
+
+        // The node can match the empty string
+        bool nullable (int node) const {
+            const Node &n = nodes[node];
+            switch (n.type) {
+                case Node::SET: return false;
+                case Node::EMPTY: case Node::ASSERT: return true;
+                case Node::REPEAT: return n.min == 0 || nullable (n.children[0]);
+                case Node::ALTERNATE:
+                    for (int child : n.children) if (nullable (child)) return true;
+                    return false;
+                default:
+                    for (int child : n.children) if (!nullable (child)) return false;
+                    return true;
+            }
+        }
+    };
+
+}
+
+
+/* ---------- PROGRAM ---------- */
+
+struct Regex::Program {
+
+    static constexpr size_t MAX_SIZE = 1 << 16;
+
+    vector<Inst> code;
+    vector<ByteSet> sets;
+    int start = 0;        // anchored entry
+    int unanchored = 0;   // entry of the lazy "any prefix" loop in front of start
+    int slots = 2;        // span slots written by OP_SAVE
+
+    unsigned char byteClass[256];
+    vector<unsigned char> representative; // one byte per class
+    int classes = 0;                      // byte classes, the end of the text comes after them
+
+    int emit (Op op, int x = 0, int y = 0) {
+        code.push_back ({op, x, y});
+        return code.size() - 1;
+    }
+
+    int emitSet (const ByteSet &set) {
+        sets.push_back (set);
+        return emit (OP_CHAR, sets.size() - 1);
+    }
+
+    // Thompson construction; the reversed program matches the reversed strings, with ^ and $
+    // swapped, and carries no captures
+    bool build (const vector<Node> &nodes, int node, bool reverse) {
+        if (code.size() > MAX_SIZE) return false;
+        const Node &n = nodes[node];
+        switch (n.type) {
+            case Node::SET:
+                emitSet (n.set);
+                return true;
+            case Node::EMPTY:
+                return true;
+            case Node::ASSERT: {
+                Assertion a = n.assertion;
+                if (reverse && a == AT_BEGIN) a = AT_END;
+                else if (reverse && a == AT_END) a = AT_BEGIN;
+                emit (OP_ASSERT, a);
+                return true;
+            }
+            case Node::CONCAT:
+                for (size_t k = 0; k < n.children.size(); k++) {
+                    if (!build (nodes, n.children[reverse ? n.children.size() - 1 - k : k], reverse)) return false;
+                }
+                return true;
+            case Node::ALTERNATE: {
+                vector<int> exits;
+                for (size_t k = 0; k + 1 < n.children.size(); k++) {
+                    int split = emit (OP_SPLIT, code.size() + 1);
+                    if (!build (nodes, n.children[k], reverse)) return false;
+                    exits.push_back (emit (OP_JMP));
+                    code[split].y = code.size();
+                }
+                if (!build (nodes, n.children.back(), reverse)) return false;
+                for (int e : exits) code[e].x = code.size();
+                return true;
+            }
+            case Node::GROUP:
+                if (!reverse) emit (OP_SAVE, 2 * n.group);
+                if (!build (nodes, n.children[0], reverse)) return false;
+                if (!reverse) emit (OP_SAVE, 2 * n.group + 1);
+                return true;
+            case Node::REPEAT:
+                return repeat (nodes, n, reverse);
+        }
+        return false;
+    }
+
+    // A split preferring next (greedy) or skip (lazy); the skip target is patched later
+    int loopSplit (bool greedy) {
+        int next = code.size() + 1;
+        return greedy ? emit (OP_SPLIT, next, -1) : emit (OP_SPLIT, -1, next);
+    }
+
+    void patchSkip (int split, int target) {
+        Inst &s = code[split];
+        (s.x == -1 ? s.x : s.y) = target;
+    }
+
+    bool repeat (const vector<Node> &nodes, const Node &n, bool reverse) {
+        int child = n.children[0];
+        int copies = n.max < 0 ? max (n.min - 1, 0) : n.min;
+        for (int k = 0; k < copies; k++) {
+            if (!build (nodes, child, reverse)) return false;
+        }
+
+        if (n.max < 0 && n.min > 0) {
+            // x+ : x, then loop back while preferred
+            int body = code.size();
+            if (!build (nodes, child, reverse)) return false;
+            emit (OP_SPLIT, n.greedy ? body : (int)code.size() + 1, n.greedy ? (int)code.size() + 1 : body);
+            return true;
+        }
+        if (n.max < 0) {
+            // x* : split over x, jump back
+            int split = loopSplit (n.greedy);
+            if (!build (nodes, child, reverse)) return false;
+            emit (OP_JMP, split);
+            patchSkip (split, code.size());
+            return true;
+        }
+
+        // x{n,m}: m - n nested optional copies
+        vector<int> splits;
+        for (int k = n.min; k < n.max; k++) {
+            splits.push_back (loopSplit (n.greedy));
+            if (!build (nodes, child, reverse)) return false;
+        }
+        for (int s : splits) patchSkip (s, code.size());
+        return true;
+    }
+
+    // Partition the bytes into classes no set tells apart (nor \b, through the word bytes)
+    void computeClasses() {
+        ByteSet word = wordSet();
+        unordered_map<string, int> ids;
+        string signature;
+        representative.clear();
+        for (int c = 0; c < 256; c++) {
+            signature.assign (1, word[c] ? '1' : '0');
+            for (const ByteSet &s : sets) signature += s[c] ? '1' : '0';
+            auto found = ids.emplace (signature, ids.size());
+            if (found.second) representative.push_back (c);
+            byteClass[c] = found.first->second;
+        }
+        classes = ids.size();
+    }
+
+    bool compile (const Parser &parser, int root, bool reverse) {
+        // lazy "any byte" prefix for unanchored searches: 0: split 3, 1; 1: any; 2: jmp 0
+        unanchored = emit (OP_SPLIT, 3, 1);
+        sets.push_back (ByteSet().set());
+        emit (OP_CHAR, 0);
+        emit (OP_JMP, 0);
+        start = code.size();
+        if (!reverse) emit (OP_SAVE, 0);
+        if (!build (parser.nodes, root, reverse)) return false;
+        if (!reverse) emit (OP_SAVE, 1);
+        emit (OP_MATCH);
+        slots = 2 * (parser.groups + 1);
+        computeClasses();
+        return code.size() <= MAX_SIZE;
+    }
+
+    // Union of several patterns, without captures: the MATCH ending pattern k carries k
+    bool compileSet (const vector<Parser> &parsers, const vector<int> &roots, const vector<size_t> &ids) {
+        unanchored = emit (OP_SPLIT, 3, 1);
+        sets.push_back (ByteSet().set());
+        emit (OP_CHAR, 0);
+        emit (OP_JMP, 0);
+        start = code.size();
+        for (size_t k = 0; k < ids.size(); k++) {
+            int split = k + 1 < ids.size() ? emit (OP_SPLIT, code.size() + 1) : -1;
+            if (!build (parsers[ids[k]].nodes, roots[ids[k]], false)) return false;
+            emit (OP_MATCH, ids[k]);
+            if (split >= 0) code[split].y = code.size();
+        }
+        computeClasses();
+        return code.size() <= MAX_SIZE;
+    }
+
+    // Whether an assertion holds between the previous byte and the next one (-1: text edges)
+    static bool holds (int assertion, int previous, int next) {
+        bool wordBefore = previous >= 0 && isWordByte (previous);
+        bool wordAfter = next >= 0 && isWordByte (next);
+        switch (assertion) {
+            case AT_BEGIN: return previous < 0;
+            case AT_END: return next < 0;
+            case WORD_BOUNDARY: return wordBefore != wordAfter;
+            default: return wordBefore == wordAfter;
+        }
+    }
+};
+
+
+/* ---------- DFA ---------- */
+
+// A state is the ordered list of program counters reached by the last byte (before their
+// epsilon closure) plus what the assertions need of the past: whether nothing was read yet
+// and whether the last byte was a word byte. Transitions are computed on first use: the
+// closure is taken knowing the next byte, so ^ $ \b \B resolve exactly. A leftmost-first DFA
+// keeps the list in priority order and drops what follows a match; a longest-match DFA keeps
+// going; an all-matches DFA also keeps every MATCH reached in its states, so the state after
+// the end of the text tells which patterns of a set matched. State 0 is the dead state.
+struct Regex::DFA {
+
+    static constexpr size_t MAX_STATES = 4096;
+    static constexpr int UNKNOWN = -1;
+
+    enum Flags : uint8_t {
+        AT_START = 1,
+        AFTER_WORD = 2
+    };
+
+    enum Mode : uint8_t {
+        LEFTMOST_FIRST,
+        LONGEST,        // anchored at the start of the scan
+        ALL_MATCHES
+    };
+
+    const Program &prog;
+    Mode mode;
+    int stride;                       // classes + 1 (the end of the text)
+    vector<vector<int>> kernels;
+    vector<uint8_t> flags;
+    vector<int> table;                // stride entries per state: (next << 1) | matched
+    unordered_map<string, int> ids;
+    int starts[4];                    // start state per flags, UNKNOWN until built
+
+    // closure scratch
+    vector<uint32_t> seen, queued;
+    uint32_t generation = 0;
+    vector<int> stack, closure, next;
+    string key;
+
+    DFA (const Program &program, Mode searchMode) : prog (program), mode (searchMode), stride (program.classes + 1),
+        seen (program.code.size() + 1, 0), queued (program.code.size() + 1, 0) {
+        reset();
+    }
+
+    void reset() {
+        kernels.clear();
+        flags.clear();
+        table.clear();
+        ids.clear();
+        for (int &s : starts) s = UNKNOWN;
+        intern (vector<int>(), 0); // dead
+    }
+
+    int intern (const vector<int> &kernel, uint8_t stateFlags) {
+        key.assign (1, (char)stateFlags);
+        key.append ((const char*)kernel.data(), kernel.size() * sizeof (int));
+        auto found = ids.emplace (key, kernels.size());
+        if (!found.second) return found.first->second;
+        kernels.push_back (kernel);
+        flags.push_back (stateFlags);
+        table.resize (table.size() + stride, UNKNOWN);
+        return kernels.size() - 1;
+    }
+
+    int start (uint8_t stateFlags) {
+        if (starts[stateFlags] == UNKNOWN) starts[stateFlags] = intern ({mode == LONGEST ? prog.start : prog.unanchored}, stateFlags);
+        return starts[stateFlags];
+    }
+
+    // Builds the transition of state on byte class cls (stride - 1: end of text); state is
+    // renumbered if the cache had to be flushed
+    int step (int &state, int cls) {
+        int byte = cls == stride - 1 ? -1 : prog.representative[cls];
+        int previous = flags[state] & AT_START ? -1 : (flags[state] & AFTER_WORD ? 'a' : ' ');
+
+        if (++generation == 0) {
+            fill (seen.begin(), seen.end(), 0);
+            fill (queued.begin(), queued.end(), 0);
+            generation = 1;
+        }
+        closure.clear();
+        const vector<int> &kernel = kernels[state];
+        for (size_t k = kernel.size(); k-- > 0; ) stack.push_back (kernel[k]);
+        while (!stack.empty()) {
+            int pc = stack.back();
+            stack.pop_back();
+            if (seen[pc] == generation) continue;
+            seen[pc] = generation;
+            const Inst &in = prog.code[pc];
+            switch (in.op) {
+                case OP_JMP: stack.push_back (in.x); break;
+                case OP_SPLIT: stack.push_back (in.y); stack.push_back (in.x); break;
+                case OP_SAVE: stack.push_back (pc + 1); break;
+                case OP_ASSERT: if (Program::holds (in.x, previous, byte)) stack.push_back (pc + 1); break;
+                default: closure.push_back (pc);
+            }
+        }
+
+        bool matched = false;
+        next.clear();
+        for (int pc : closure) {
+            const Inst &in = prog.code[pc];
+            if (in.op == OP_MATCH) {
+                matched = true;
+                if (mode == LEFTMOST_FIRST) break;
+                if (mode == ALL_MATCHES && queued[pc] != generation) {
+                    queued[pc] = generation;
+                    next.push_back (pc);
+                }
+                continue;
+            }
+            if (byte >= 0 && prog.sets[in.x][byte] && queued[pc + 1] != generation) {
+                queued[pc + 1] = generation;
+                next.push_back (pc + 1);
+            }
+        }
+
+        int target = 0;
+        if (!next.empty() && (byte >= 0 || mode == ALL_MATCHES)) {
+            if (kernels.size() >= MAX_STATES) {
+                // flush the cache and carry on from a copy of the current state
+                vector<int> current = kernels[state];
+                uint8_t currentFlags = flags[state];
+                reset();
+                state = intern (current, currentFlags);
+            }
+            target = intern (next, byte >= 0 && isWordByte (byte) ? AFTER_WORD : 0);
+        }
+        int value = (target << 1) | (matched ? 1 : 0);
+        table[state * stride + cls] = value;
+        return value;
+    }
+
+    // Leftmost-first: end of the match starting first, -1 if none
+    ptrdiff_t matchEnd (string_view text) {
+        int state = start (AT_START);
+        ptrdiff_t end = -1;
+        const unsigned char* data = (const unsigned char*)text.data();
+        size_t n = text.size();
+        for (size_t i = 0; ; i++) {
+            int cls = i < n ? prog.byteClass[data[i]] : stride - 1;
+            int value = table[state * stride + cls];
+            if (value == UNKNOWN) value = step (state, cls);
+            if (value & 1) end = i;
+            state = value >> 1;
+            if (state == 0 || i == n) return end;
+        }
+    }
+
+    // All matches: the patterns with a match in text, from their MATCH instructions
+    void matchingPatterns (string_view text, vector<size_t> &patterns) {
+        int state = start (AT_START);
+        const unsigned char* data = (const unsigned char*)text.data();
+        size_t n = text.size();
+        for (size_t i = 0; state != 0 && i <= n; i++) {
+            int cls = i < n ? prog.byteClass[data[i]] : stride - 1;
+            int value = table[state * stride + cls];
+            if (value == UNKNOWN) value = step (state, cls);
+            state = value >> 1;
+        }
+        for (int pc : kernels[state]) {
+            if (prog.code[pc].op == OP_MATCH) patterns.push_back (prog.code[pc].x);
+        }
+    }
+
+    // Longest match of the reversed program ending at end, read backwards: the leftmost
+    // start of a match that ends there
+    ptrdiff_t matchStart (string_view text, size_t end) {
+        const unsigned char* data = (const unsigned char*)text.data();
+        uint8_t stateFlags = end == text.size() ? AT_START : (isWordByte (data[end]) ? AFTER_WORD : 0);
+        int state = start (stateFlags);
+        ptrdiff_t begin = -1;
+        for (size_t i = end; ; i--) {
+            int cls = i > 0 ? prog.byteClass[data[i - 1]] : stride - 1;
+            int value = table[state * stride + cls];
+            if (value == UNKNOWN) value = step (state, cls);
+            if (value & 1) begin = i;
+            state = value >> 1;
+            if (state == 0 || i == 0) return begin;
+        }
+    }
+};
+
+
+/* ---------- CONSTRUCTORS ---------- */
+
+Regex::Regex() : builtinEngine (false), wholeMatchGroup (false), groupCount (0), generation (0) {}
+
+Regex::~Regex() = default;
+
+
+/* ---------- BASIC METHODS ---------- */
+
+bool Regex::compile (const string &pattern, RegexEngine engine) {
+    program.reset();
+    reversed.reset();
+    forward.reset();
+    backward.reset();
+    builtinEngine = false;
+    wholeMatchGroup = false;
+    try {
+        fallback.assign (pattern);
+    } catch (const regex_error &e) {
+        return false;
+    }
+    groupCount = fallback.mark_count();
+    if (engine == REGEX_STD) return true;
+
+    Parser parser (pattern);
+    int root = parser.parse();
+    if (!parser.supported || (size_t)parser.groups != groupCount) return true;
+
+    program = make_unique<Program>();
+    reversed = make_unique<Program>();
+    if (!program->compile (parser, root, false) || !reversed->compile (parser, root, true)) return true;
+    // "(...)": the only group is the whole match, no Pike VM needed
+    wholeMatchGroup = groupCount == 1 && parser.nodes[root].type == Node::GROUP;
+    forward = make_unique<DFA> (*program, DFA::LEFTMOST_FIRST);
+    backward = make_unique<DFA> (*reversed, DFA::LONGEST);
+    visited.assign (program->code.size(), 0);
+    builtinEngine = true;
+    return true;
+}
+
+bool Regex::builtin() const {
+    return builtinEngine;
+}
+
+size_t Regex::groups() const {
+    return groupCount;
+}
+
+
+/* ---------- SEARCH ---------- */
+
+bool Regex::search (string_view text, vector<ptrdiff_t> &spans) {
+    spans.assign (2 * (groupCount + 1), -1);
+
+    if (!builtinEngine) {
+        cmatch match;
+        if (!regex_search (text.data(), text.data() + text.size(), match, fallback)) return false;
+        for (size_t g = 0; g < match.size() && g <= groupCount; g++) {
+            if (!match[g].matched) continue;
+            spans[2 * g] = match[g].first - text.data();
+            spans[2 * g + 1] = match[g].second - text.data();
+        }
+        return true;
+    }
+
+    ptrdiff_t end = forward->matchEnd (text);
+    if (end < 0) return false;
+    ptrdiff_t start = backward->matchStart (text, end);
+    if (start < 0) return false;
+    if (groupCount == 0 || wholeMatchGroup) {
+        for (size_t g = 0; g <= groupCount; g++) {
+            spans[2 * g] = start;
+            spans[2 * g + 1] = end;
+        }
+        return true;
+    }
+    if (program->code.size() * (end - start + 1) <= MAX_BACKTRACK_BITS) return backtrack (text, start, end, spans);
+    return captures (text, start, spans);
+}
+
+// Depth-first over (pc, position) in priority order, each pair tried once: the first MATCH
+// reached is the leftmost-first one. Positions stay within the match found by the DFAs.
+bool Regex::backtrack (string_view text, size_t start, size_t end, vector<ptrdiff_t> &spans) {
+    const Program &prog = *program;
+    const unsigned char* data = (const unsigned char*)text.data();
+    size_t n = text.size();
+    size_t width = end - start + 1;
+    positionBits.assign ((prog.code.size() * width + 63) / 64, 0);
+
+    vector<ptrdiff_t> &current = threadCurrent;
+    vector<pair<int, ptrdiff_t>> &stack = threadStack;
+    current.assign (prog.slots, -1);
+    stack.clear();
+    stack.push_back ({prog.start, start});
+    while (!stack.empty()) {
+        auto [pc, position] = stack.back();
+        stack.pop_back();
+        if (pc < 0) {
+            current[-pc - 1] = position;
+            continue;
+        }
+        size_t bit = pc * width + (position - start);
+        if (positionBits[bit / 64] >> (bit % 64) & 1) continue;
+        positionBits[bit / 64] |= (uint64_t)1 << (bit % 64);
+
+        const Inst &in = prog.code[pc];
+        switch (in.op) {
+            case OP_CHAR:
+                if ((size_t)position < end && prog.sets[in.x][data[position]]) stack.push_back ({pc + 1, position + 1});
+                break;
+            case OP_JMP: stack.push_back ({in.x, position}); break;
+            case OP_SPLIT: stack.push_back ({in.y, position}); stack.push_back ({in.x, position}); break;
+            case OP_SAVE:
+                stack.push_back ({-in.x - 1, current[in.x]});
+                current[in.x] = position;
+                stack.push_back ({pc + 1, position});
+                break;
+            case OP_ASSERT: {
+                int previous = position > 0 ? data[position - 1] : -1;
+                int next = (size_t)position < n ? data[position] : -1;
+                if (Program::holds (in.x, previous, next)) stack.push_back ({pc + 1, position});
+                break;
+            }
+            case OP_MATCH:
+                copy (current.begin(), current.end(), spans.begin());
+                return true;
+        }
+    }
+    return false;
+}
+
+// Pike VM anchored at start, for matches too long to backtrack over: threads in priority order, each with its own spans; the
+// first thread to reach MATCH drops the ones after it
+bool Regex::captures (string_view text, size_t start, vector<ptrdiff_t> &spans) {
+    const Program &prog = *program;
+    const unsigned char* data = (const unsigned char*)text.data();
+    size_t n = text.size();
+    size_t slots = prog.slots;
+    bool matched = false;
+
+    vector<ptrdiff_t> &current = threadCurrent;
+    vector<pair<int, ptrdiff_t>> &stack = threadStack;
+    current.assign (slots, -1);
+
+    auto nextGeneration = [&]() {
+        if (++generation == 0) {
+            fill (visited.begin(), visited.end(), 0);
+            generation = 1;
+        }
+    };
+    // epsilon closure of pc at position into list; a program counter joins a list at most once
+    auto add = [&](int list, int pc, size_t position) {
+        int previous = position > 0 ? data[position - 1] : -1;
+        int next = position < n ? data[position] : -1;
+        stack.push_back ({pc, 0});
+        while (!stack.empty()) {
+            auto [at, value] = stack.back();
+            stack.pop_back();
+            if (at < 0) {
+                current[-at - 1] = value;
+                continue;
+            }
+            if (visited[at] == generation) continue;
+            visited[at] = generation;
+            const Inst &in = prog.code[at];
+            switch (in.op) {
+                case OP_JMP: stack.push_back ({in.x, 0}); break;
+                case OP_SPLIT: stack.push_back ({in.y, 0}); stack.push_back ({in.x, 0}); break;
+                case OP_SAVE:
+                    stack.push_back ({-in.x - 1, current[in.x]});
+                    current[in.x] = position;
+                    stack.push_back ({at + 1, 0});
+                    break;
+                case OP_ASSERT: if (Program::holds (in.x, previous, next)) stack.push_back ({at + 1, 0}); break;
+                default:
+                    threadPcs[list].push_back (at);
+                    threadSpans[list].insert (threadSpans[list].end(), current.begin(), current.end());
+            }
+        }
+    };
+
+    for (int l = 0; l < 2; l++) {
+        threadPcs[l].clear();
+        threadSpans[l].clear();
+    }
+    nextGeneration();
+    add (0, prog.start, start);
+    int list = 0;
+    for (size_t position = start; !threadPcs[list].empty(); position++) {
+        int other = list ^ 1;
+        threadPcs[other].clear();
+        threadSpans[other].clear();
+        nextGeneration();
+        for (size_t t = 0; t < threadPcs[list].size(); t++) {
+            const Inst &in = prog.code[threadPcs[list][t]];
+            const ptrdiff_t* own = &threadSpans[list][t * slots];
+            if (in.op == OP_MATCH) {
+                matched = true;
+                copy (own, own + slots, spans.begin());
+                break;
+            }
+            if (position < n && prog.sets[in.x][data[position]]) {
+                current.assign (own, own + slots);
+                add (other, threadPcs[list][t] + 1, position + 1);
+            }
+        }
+        if (position >= n) break;
+        list = other;
+    }
+    return matched;
+}
+
+
+/* ---------- REGEX SET ---------- */
+
+RegexSet::RegexSet() {}
+
+RegexSet::~RegexSet() = default;
+
+bool RegexSet::compile (const vector<string> &patterns, RegexEngine engine) {
+    regexes.clear();
+    alwaysSearched.clear();
+    dfa.reset();
+    program.reset();
+
+    vector<Parser> parsers;
+    vector<int> roots;
+    vector<size_t> builtin;
+    for (size_t k = 0; k < patterns.size(); k++) {
+        regexes.push_back (make_unique<Regex>());
+        if (!regexes[k]->compile (patterns[k], engine)) return false;
+        parsers.emplace_back (patterns[k]);
+        roots.push_back (parsers.back().parse());
+        if (regexes[k]->builtin()) builtin.push_back (k);
+        else alwaysSearched.push_back (k);
+    }
+    if (builtin.empty()) return true;
+
+    program = make_unique<Regex::Program>();
+    if (program->compileSet (parsers, roots, builtin)) {
+        dfa = make_unique<Regex::DFA> (*program, Regex::DFA::ALL_MATCHES);
+    }
+    else {
+        program.reset();
+        alwaysSearched.clear();
+        for (size_t k = 0; k < patterns.size(); k++) alwaysSearched.push_back (k);
+    }
+    return true;
+}
+
+size_t RegexSet::size() const {
+    return regexes.size();
+}
+
+Regex& RegexSet::pattern (size_t index) {
+    return *regexes[index];
+}
+
+void RegexSet::matching (string_view text, vector<size_t> &patterns) {
+    patterns.clear();
+    if (dfa) dfa->matchingPatterns (text, patterns);
+    patterns.insert (patterns.end(), alwaysSearched.begin(), alwaysSearched.end());
+    sort (patterns.begin(), patterns.end());
+}
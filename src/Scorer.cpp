@@ -0,0 +1,51 @@
+#include "Scorer.h"
+using namespace std;
+
+
+/* ==================== Constructor ==================== */
+
+Scorer::Scorer(const StatTrie &trie, const Analysis &analysis) :
+    trie(&trie),
+    freqThreshold(analysis.frequencyThreshold()),
+    lenFreqThreshold(analysis.lengthFrequencyThreshold()),
+    entropyThreshold(analysis.localEntropyThreshold()) {
+
+    for (const pair<const unsigned, unsigned> &p : analysis.lengthFrequencies()) {
+        if (p.first >= lenFreq.size()) lenFreq.resize(p.first + 1, 0);
+        lenFreq[p.first] = p.second;
+    }
+}
+
+
+/* ==================== Scoring ==================== */
+
+LineScore Scorer::score(string_view line) const {
+    WordMatch m = trie->match(line);
+
+    LineScore s;
+    s.frequency = m.endCount;
+    s.divergeDepth = m.depth;
+    s.branchEntropy = m.entropy;
+    s.length = m.length;
+    s.lengthFrequency = m.length < lenFreq.size() ? lenFreq[m.length] : 0;
+    s.categories = (s.frequency <= freqThreshold ? FREQ_ANOMALY : 0)
+                 | (s.lengthFrequency <= lenFreqThreshold ? LEN_ANOMALY : 0)
+                 | (s.frequency == 0 && s.branchEntropy >= entropyThreshold ? ENTROPY_ANOMALY : 0);
+    return s;
+}
+
+void Scorer::score(const vector<string_view> &lines, vector<LineScore> &scores) const {
+    scores.resize(lines.size());
+    for (size_t i = 0; i < lines.size(); ++i) scores[i] = score(lines[i]);
+}
+
+void Scorer::scoreBuffer(string_view buffer, vector<LineScore> &scores) const {
+    scores.clear();
+    size_t i = 0;
+    while (i < buffer.size()) {
+        size_t j = buffer.find('\n', i);
+        if (j == string_view::npos) j = buffer.size();
+        scores.push_back(score(buffer.substr(i, j - i)));
+        i = j + 1;
+    }
+}
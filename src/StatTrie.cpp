@@ -1,159 +1,556 @@
 #include "StatTrie.h"
+#include "Entropy.h"
 using namespace std;
 using json = nlohmann::json;
 
 
 /* ---------- Node ---------- */
 
-Node::Node() : count(0), isEnd(false) {}
+Node::Node() : bucket(nullptr), count(0), endCount(0), entropySum(0), isEnd(false) {}
 
 unsigned Node::countEnd() const {
-    unsigned result = count;
-    for (const pair<const char, Node*> &p : children) result -= p.second->count;
-    return result;
+    return endCount;
+}
+
+
+/* ---------- NodePool ---------- */
+
+NodePool::NodePool() : used(BLOCK_SIZE) {}
+
+NodePool::~NodePool() {
+    clear();
+}
+
+Node* NodePool::acquire() {
+    if (!freeList.empty()) {
+        Node* node = freeList.back();
+        freeList.pop_back();
+        return node;
+    }
+    if (used == BLOCK_SIZE) {
+        blocks.push_back (new Node[BLOCK_SIZE]);
+        used = 0;
+    }
+    return blocks.back() + used++;
+}
+
+void NodePool::release (Node* node) {
+    unordered_map<Symbol, Node*>().swap (node->children);
+    node->bucket = nullptr;
+    node->count = 0;
+    node->endCount = 0;
+    node->entropySum = 0;
+    node->isEnd = false;
+    freeList.push_back (node);
+}
+
+void NodePool::clear() {
+    for (Node* block : blocks) delete[] block;
+    blocks.clear();
+    freeList.clear();
+    used = BLOCK_SIZE;
+}
+
+void NodePool::swap (NodePool &other) {
+    blocks.swap (other.blocks);
+    freeList.swap (other.freeList);
+    std::swap (used, other.used);
+}
+
+size_t NodePool::totalBlocks() const {
+    return blocks.size();
+}
+
+size_t NodePool::totalFreeSlots() const {
+    return freeList.size();
 }
 
 
 /* ---------- CONSTRUCTORS AND DESTRUCTORS ---------- */
 
 StatTrie::StatTrie() :
-    root(new Node),
+    root(pool.acquire()),
     countNodes(1),
     countUniqueWordChar(0),
     countUniqueWords(0),
-    countInsertedWords(0) {}
+    countInsertedWords(0),
+    symbols(nullptr),
+    burstThreshold(0),
+    countContainers(0),
+    countContainerEntries(0) {}
 
 StatTrie::~StatTrie() {
-    clear();
+    _clear(root);
 }
 
 
 /* ---------- HELPERS ---------- */
 
+static inline Symbol toSymbol (char c) { return (unsigned char)c; }
+static inline Symbol toSymbol (Symbol s) { return s; }
+
+using entropy::nlog2n;
+
+typedef vector<pair<string_view, unsigned>> ContainerEntries;
+
+struct ContainerGroup {
+    char c;
+    size_t lo, hi;
+    unsigned count;
+};
+
+// Split sorted entries[lo, hi), which share their first depth characters, by the character at depth.
+// Returns the count of the entry ending exactly at depth (it sorts first), 0 if there is none.
+static unsigned groupContainerRange (const ContainerEntries &entries, size_t lo, size_t hi, size_t depth, vector<ContainerGroup> &groups) {
+    unsigned endCount = 0;
+    if (lo < hi && entries[lo].first.size() == depth) endCount = entries[lo++].second;
+    groups.clear();
+    while (lo < hi) {
+        ContainerGroup g { entries[lo].first[depth], lo, lo, 0 };
+        while (g.hi < hi && entries[g.hi].first[depth] == g.c) g.count += entries[g.hi++].second;
+        groups.push_back (g);
+        lo = g.hi;
+    }
+    return endCount;
+}
+
+// Sum of c*log2(c) over the outcomes of node, added in ascending order of count: unlike the
+// aggregate kept by insert/remove, it depends on the counts only, not on the updates behind them
+static double canonicalEntropySum (const Node* node) {
+    vector<unsigned> counts { node->endCount };
+    for (const pair<const Symbol, Node*> &p : node->children) counts.push_back (p.second->count);
+    sort (counts.begin(), counts.end());
+    return entropy::sumNLog2N (counts.data(), counts.size());
+}
+
+void StatTrie::_recomputeEntropySums (Node* node) {
+    node->entropySum = canonicalEntropySum (node);
+    for (pair<const Symbol, Node*> &p : node->children) _recomputeEntropySums (p.second);
+}
+
+// Free the containers below node; the nodes themselves are owned by the pool
 void StatTrie::_clear (Node* node) {
     if (!node) return;
-    for (pair<const char, Node*> p : node->children) _clear(p.second);
-    delete node;
+    for (pair<const Symbol, Node*> p : node->children) _clear(p.second);
+    delete node->bucket;
+    node->bucket = nullptr;
+}
+
+// Copy the subtree of node into target in preorder, parents before their children
+Node* StatTrie::relocate (const Node* node, NodePool &target) {
+    Node* copy = target.acquire();
+    copy->bucket = node->bucket;
+    copy->count = node->count;
+    copy->endCount = node->endCount;
+    copy->entropySum = canonicalEntropySum (node);
+    copy->isEnd = node->isEnd;
+    copy->children.reserve (node->children.size());
+    for (const pair<const Symbol, Node*> &p : node->children) copy->children.emplace (p.first, nullptr);
+    for (pair<const Symbol, Node*> &p : copy->children) p.second = relocate (node->children.at(p.first), target);
+    return copy;
 }
 
 void StatTrie::_traverse (function<void(const Node*, const string&)> &callback, const Node* currNode, string &prefix) const {
+    if (currNode->bucket) {
+        ContainerEntries entries = currNode->bucket->sortedEntries();
+        _traverseRange (callback, currNode, entries, 0, entries.size(), 0, prefix);
+        return;
+    }
     callback (currNode, prefix);
-    for (const pair<const char, Node*> &p : currNode->children) {
-        prefix.push_back (p.first);
+    for (const pair<const Symbol, Node*> &p : currNode->children) {
+        size_t mark = prefix.size();
+        appendKey (prefix, p.first);
         _traverse (callback, p.second, prefix);
+        prefix.resize (mark);
+    }
+}
+
+// Visit the virtual subtree spelled by container entries[lo, hi) at the given depth below
+// the container's owner. Statistics are computed on the fly into a temporary view node.
+void StatTrie::_traverseRange (function<void(const Node*, const string&)> &callback, const Node* owner,
+                               const ContainerEntries &entries, size_t lo, size_t hi, size_t depth, string &prefix) const {
+    vector<ContainerGroup> groups;
+    unsigned endCount = groupContainerRange (entries, lo, hi, depth, groups);
+
+    Node view;
+    vector<Node> kids (groups.size());
+    if (owner) {
+        view.count = owner->count;
+        view.endCount = owner->endCount;
+        view.isEnd = owner->isEnd;
+    }
+    else {
+        view.count = view.endCount = endCount;
+        view.isEnd = endCount > 0;
+        for (const ContainerGroup &g : groups) view.count += g.count;
+    }
+    vector<unsigned> counts { view.endCount };
+    for (size_t i = 0; i < groups.size(); ++i) {
+        kids[i].count = groups[i].count;
+        counts.push_back (groups[i].count);
+        view.children[toSymbol(groups[i].c)] = &kids[i];
+    }
+    view.entropySum = entropy::sumNLog2N (counts.data(), counts.size());
+    callback (&view, prefix);
+
+    for (const ContainerGroup &g : groups) {
+        prefix.push_back (g.c);
+        _traverseRange (callback, nullptr, entries, g.lo, g.hi, depth + 1, prefix);
         prefix.pop_back();
     }
 }
 
+// Split a word into token ids as Preprocessor::tokenize does; false if a token is unknown and
+// intern is off
+bool StatTrie::splitTokens (string_view word, vector<Symbol> &keys, bool intern) const {
+    keys.clear();
+    size_t i = 0;
+    for (string_view token; !(token = SymbolTable::nextToken (word, i)).empty(); ) {
+        Symbol id = intern ? symbols->intern(token) : symbols->find(token);
+        if (id == SymbolTable::npos) return false;
+        keys.push_back (id);
+    }
+    return true;
+}
+
+void StatTrie::appendKey (string &prefix, Symbol key) const {
+    if (!symbols) {
+        prefix.push_back ((char)key);
+        return;
+    }
+    if (!prefix.empty()) prefix.push_back (' ');
+    prefix.append (symbols->lookup(key));
+}
 
-/* ---------- BASIC METHODS ---------- */
+string StatTrie::keyLabel (Symbol key) const {
+    if (!symbols) return string(1, (char)key);
+    return string(symbols->lookup(key));
+}
 
-void StatTrie::insert (string word) {
-    if (word.size() == 0) return;
-    Node* ptr = root;
-    for (char c : word) {
-        if (!ptr->children.count(c)) {
-            ptr->children[c] = new Node;
+void StatTrie::insertIntoContainer (Node* owner, string_view suffix, unsigned num, size_t wordLength) {
+    countInsertedWords += num;
+    if (owner->bucket->add (suffix, num)) {
+        ++countContainerEntries;
+        ++countUniqueWords;
+        countUniqueWordChar += wordLength;
+    }
+    if (owner->bucket->size() > burstThreshold) burst (owner);
+}
+
+// Replace the container of node by real children, each holding the rest of its suffixes
+void StatTrie::burst (Node* node) {
+    ArrayHash* container = node->bucket;
+    node->bucket = nullptr;
+    --countContainers;
+    countContainerEntries -= container->size();
+
+    container->forEach ([&] (string_view suffix, unsigned num) {
+        Node* &child = node->children[toSymbol(suffix[0])];
+        if (!child) {
+            child = pool.acquire();
             ++countNodes;
         }
-        ptr = ptr->children[c];
-        ++(ptr->count);
+        child->count += num;
+        if (suffix.size() == 1) {
+            child->isEnd = true;
+            child->endCount += num;
+            return;
+        }
+        if (!child->bucket) {
+            child->bucket = new ArrayHash;
+            ++countContainers;
+        }
+        child->bucket->add (suffix.substr(1), num);
+        ++countContainerEntries;
+    });
+    delete container;
+
+    // containers keep no aggregate, so it is rebuilt for the node and its new children
+    vector<unsigned> counts { node->endCount };
+    for (pair<const Symbol, Node*> &p : node->children) {
+        counts.push_back (p.second->count);
+        p.second->entropySum = nlog2n (p.second->endCount);
     }
+    node->entropySum = entropy::sumNLog2N (counts.data(), counts.size());
+    for (pair<const Symbol, Node*> &p : node->children)
+        if (p.second->bucket && p.second->bucket->size() > burstThreshold) burst (p.second);
+}
 
-    // countInsertedChar += word.size();
-    ++countInsertedWords;
-    if (!ptr->isEnd) {
-        ptr->isEnd = true;
-        ++countUniqueWords;
-        countUniqueWordChar += word.size();
+void StatTrie::deleteNode (Node* node) {
+    if (node->bucket) {
+        countContainerEntries -= node->bucket->size();
+        --countContainers;
+        delete node->bucket;
     }
+    pool.release (node);
+    --countNodes;
 }
 
-void StatTrie::insert (string word, unsigned num) {
-    if (word.size() == 0) return;
+template <typename Keys>
+void StatTrie::_insert (const Keys& keys, unsigned num) {
+    const size_t n = keys.size();
+    if (n == 0) return;
     Node* ptr = root;
-    for (char c : word) {
-        if (!ptr->children.count(c)) {
-            ptr->children[c] = new Node;
+    for (size_t i = 0; i < n; ++i) {
+        Symbol c = toSymbol(keys[i]);
+        Node* parent = ptr;
+        unordered_map<Symbol, Node*>::iterator it = ptr->children.find (c);
+        if (it == ptr->children.end()) {
+            Node* child = pool.acquire();
             ++countNodes;
+            // burst mode: a new sparse subtree starts out as a single container
+            if (burstThreshold && i + 1 < n) {
+                child->bucket = new ArrayHash;
+                ++countContainers;
+            }
+            ptr->children[c] = child;
+            ptr = child;
         }
-        ptr = ptr->children[c];
+        else ptr = it->second;
+        parent->entropySum += nlog2n (ptr->count + num) - nlog2n (ptr->count);
         ptr->count += num;
+
+        if constexpr (is_same_v<Keys, string_view>) {
+            if (ptr->bucket && i + 1 < n) {
+                insertIntoContainer (ptr, keys.substr(i + 1), num, n);
+                return;
+            }
+        }
     }
 
-    // countInsertedChar += word.size() * num;
+    ptr->entropySum += nlog2n (ptr->endCount + num) - nlog2n (ptr->endCount);
+    ptr->endCount += num;
+
+    // countInsertedChar += keys.size() * num;
     countInsertedWords += num;
     if (!ptr->isEnd) {
         ptr->isEnd = true;
         ++countUniqueWords;
-        countUniqueWordChar += word.size();
+        countUniqueWordChar += keys.size();
     }
 }
 
-bool StatTrie::contains (string word) const {
+template <typename Keys>
+bool StatTrie::_contains (const Keys& keys) const {
     const Node* ptr = root;
-    for (char c : word) {
-        unordered_map<char, Node*>::const_iterator it = ptr->children.find (c);
+    for (size_t i = 0; i < keys.size(); ++i) {
+        unordered_map<Symbol, Node*>::const_iterator it = ptr->children.find (toSymbol(keys[i]));
         if (it != ptr->children.end()) ptr = (*it).second;
         else return false;
+        if constexpr (is_same_v<Keys, string_view>) {
+            if (ptr->bucket && i + 1 < keys.size()) return ptr->bucket->find (keys.substr(i + 1)) > 0;
+        }
     }
     if (ptr->isEnd) return true;
     return false;
 }
 
-bool StatTrie::startWith (string prefix) const {
+template <typename Keys>
+bool StatTrie::_startWith (const Keys& keys) const {
     const Node* ptr = root;
-    for (char c : prefix) {
-        unordered_map<char, Node*>::const_iterator it = ptr->children.find (c);
+    for (size_t i = 0; i < keys.size(); ++i) {
+        unordered_map<Symbol, Node*>::const_iterator it = ptr->children.find (toSymbol(keys[i]));
         if (it != ptr->children.end()) ptr = (*it).second;
         else return false;
+        if constexpr (is_same_v<Keys, string_view>) {
+            if (ptr->bucket && i + 1 < keys.size()) return ptr->bucket->hasPrefix (keys.substr(i + 1));
+        }
     }
     return true;
 }
 
-void StatTrie::remove (string word) {
+template <typename Keys>
+void StatTrie::_remove (const Keys& keys) {
 
-    const size_t n = word.size();
+    const size_t n = keys.size();
+    size_t depth = n; // number of real nodes on the path
+    unsigned reduction = 0;
     Node* ptr = root;
-    Node* stack[n+1];
+    vector<Node*> stack (n+1);
     stack[0] = root;
     for (size_t i = 0; i < n; ++i) {
-        if (ptr->children.count(word[i])) {
-            ptr = ptr->children[word[i]];
+        Symbol c = toSymbol(keys[i]);
+        if (ptr->children.count(c)) {
+            ptr = ptr->children[c];
             stack[i+1] = ptr;
         }
         else return;
+        if constexpr (is_same_v<Keys, string_view>) {
+            if (ptr->bucket && i + 1 < n) {
+                reduction = ptr->bucket->erase (keys.substr(i + 1));
+                if (!reduction) return;
+                --countContainerEntries;
+                depth = i + 1;
+                break;
+            }
+        }
     }
 
-    if (ptr->isEnd) {
-        ptr->isEnd = false;
-        unsigned reduction = ptr->countEnd();
-        // for (pair<const char, Node*>& p : ptr->children) reduction -= p.second->count;
-        for (int i = n-1; i >= 0; --i) {
+    if (depth < n || ptr->isEnd) {
+        if (depth == n) {
+            ptr->isEnd = false;
+            reduction = ptr->endCount;
+            ptr->entropySum -= nlog2n (ptr->endCount);
+            ptr->endCount = 0;
+        }
+        for (int i = depth-1; i >= 0; --i) {
+            stack[i]->entropySum += nlog2n (stack[i+1]->count - reduction) - nlog2n (stack[i+1]->count);
             stack[i+1]->count -= reduction;
             if (stack[i+1]->count == 0) {
-                delete stack[i+1];
-                --countNodes;
-                stack[i]->children.erase(word[i]);
+                deleteNode (stack[i+1]);
+                stack[i]->children.erase(toSymbol(keys[i]));
             }
         }
         --countUniqueWords;
-        countUniqueWordChar -= word.size();
+        countUniqueWordChar -= n;
         countInsertedWords -= reduction;
         // countInsertedChar -= n * reduction;
     }
 }
 
+
+/* ---------- BASIC METHODS ---------- */
+
+void StatTrie::insert (string_view word) {
+    insert (word, 1);
+}
+
+void StatTrie::insert (string_view word, unsigned num) {
+    if (!symbols) {
+        _insert (word, num);
+        return;
+    }
+    splitTokens (word, keyBuffer, true);
+    _insert (keyBuffer, num);
+}
+
+void StatTrie::insert (const vector<Symbol> &word) {
+    _insert (word, 1);
+}
+
+void StatTrie::insert (const vector<Symbol> &word, unsigned num) {
+    _insert (word, num);
+}
+
+bool StatTrie::contains (string_view word) const {
+    if (!symbols) return _contains (word);
+    vector<Symbol> keys;
+    return splitTokens (word, keys, false) && _contains (keys);
+}
+
+bool StatTrie::startWith (string_view prefix) const {
+    if (!symbols) return _startWith (prefix);
+    vector<Symbol> keys;
+    return splitTokens (prefix, keys, false) && _startWith (keys);
+}
+
+void StatTrie::remove (string_view word) {
+    if (!symbols) {
+        _remove (word);
+        return;
+    }
+    if (splitTokens (word, keyBuffer, false)) _remove (keyBuffer);
+}
+
 void StatTrie::clear() {
     _clear(root);
-    root = new Node;
+    pool.clear();
+    root = pool.acquire();
     countInsertedWords = countUniqueWords = countUniqueWordChar = 0;
+    countContainers = countContainerEntries = 0;
     countNodes = 1;
 }
 
+void StatTrie::compact() {
+    NodePool fresh;
+    root = relocate (root, fresh);
+    pool.swap (fresh);
+}
+
+void StatTrie::recomputeEntropySums() {
+    _recomputeEntropySums (root);
+}
+
+void StatTrie::setSymbolTable (SymbolTable* table) {
+    if (countNodes > 1) {
+        cerr << "[ERROR] Symbol table must be set before inserting into the trie" << endl;
+        return;
+    }
+    if (table && burstThreshold) {
+        cerr << "[ERROR] Burst containers are only supported with character keys" << endl;
+        return;
+    }
+    symbols = table;
+}
+
+SymbolTable* StatTrie::symbolTable() const {
+    return symbols;
+}
+
+// Number of keys (characters or tokens) in a prefix produced by traverse
+unsigned StatTrie::depthOf (const string &prefix) const {
+    if (!symbols) return prefix.size();
+    if (prefix.empty()) return 0;
+    return 1 + count (prefix.begin(), prefix.end(), ' ');
+}
+
+
+void StatTrie::setBurstThreshold (unsigned threshold) {
+    if (countNodes > 1) {
+        cerr << "[ERROR] Burst threshold must be set before inserting into the trie" << endl;
+        return;
+    }
+    if (threshold && symbols) {
+        cerr << "[ERROR] Burst containers are only supported with character keys" << endl;
+        return;
+    }
+    burstThreshold = threshold;
+}
+
+unsigned StatTrie::containerThreshold() const {
+    return burstThreshold;
+}
+
 
 /* ---------- STATISTICAL METHODS ---------- */
 
+LayoutStatistics StatTrie::layoutStatistics() const {
+    LayoutStatistics stats { 0, pool.totalBlocks(), pool.totalFreeSlots(), 0, 0 };
+    const Node* prev = nullptr;
+    size_t sequential = 0;
+    double jumps = 0;
+
+    vector<const Node*> stack { root };
+    while (!stack.empty()) {
+        const Node* node = stack.back();
+        stack.pop_back();
+        if (prev) {
+            if (node == prev + 1) ++sequential;
+            jumps += abs ((const char*)node - (const char*)prev);
+        }
+        prev = node;
+        ++stats.nodes;
+        // push in reverse so children are visited in iteration order, like traverse
+        size_t mark = stack.size();
+        for (const pair<const Symbol, Node*> &p : node->children) stack.push_back (p.second);
+        reverse (stack.begin() + mark, stack.end());
+    }
+
+    if (stats.nodes > 1) {
+        stats.sequentialRate = (double)sequential / (stats.nodes - 1);
+        stats.meanJump = jumps / (stats.nodes - 1);
+    }
+    return stats;
+}
+
+unsigned StatTrie::totalContainers() const {
+    return countContainers;
+}
+
+unsigned StatTrie::totalContainerEntries() const {
+    return countContainerEntries;
+}
+
 unsigned StatTrie::totalNodes() const {
     return countNodes;
 }
@@ -182,14 +579,192 @@ void StatTrie::traverse (const string prefix, function<void(const Node*, const s
     const Node* ptr = root;
     callback(ptr, "");
     string _prefix;
-    for (char c : prefix) {
+    vector<Symbol> keys;
+    if (symbols) splitTokens (prefix, keys, false);
+    else for (char c : prefix) keys.push_back (toSymbol(c));
+    for (Symbol c : keys) {
         if (!ptr->children.count(c) || !ptr) return;
-        _prefix.push_back(c);
+        appendKey (_prefix, c);
         ptr = ptr->children.at(c);
         callback (ptr, _prefix);
     }
 }
 
+// Local entropy of a node from its maintained aggregates; a single outcome has none
+static double nodeEntropy (const Node* node, unsigned count) {
+    size_t outcomes = node->children.size() + (node->endCount > 0);
+    return outcomes < 2 ? 0 : entropy::localEntropy (count, node->entropySum);
+}
+
+// Match the rest of a word inside the container of owner: the deepest prefix shared with a stored
+// suffix, and the distribution of stored suffixes right below it
+static void matchContainer (const Node* owner, string_view rest, WordMatch &result) {
+    size_t best = 0;
+    owner->bucket->forEach ([&] (string_view key, unsigned) {
+        size_t n = min (key.size(), rest.size()), l = 0;
+        while (l < n && key[l] == rest[l]) ++l;
+        best = max (best, l);
+    });
+
+    unsigned next[256] = {};
+    unsigned count = 0, endCount = 0;
+    owner->bucket->forEach ([&] (string_view key, unsigned num) {
+        if (key.size() < best || key.compare (0, best, rest, 0, best) != 0) return;
+        count += num;
+        if (key.size() == best) endCount += num;
+        else next[(unsigned char)key[best]] += num;
+    });
+    if (best == 0) {
+        count = owner->count;
+        endCount = owner->endCount;
+    }
+
+    unsigned counts[257];
+    size_t n = 0;
+    counts[n++] = endCount;
+    for (unsigned c : next) if (c) counts[n++] = c;
+
+    result.depth += best;
+    result.count = count;
+    result.endCount = best == rest.size() ? endCount : 0;
+    result.entropy = entropy::localEntropy (counts, n);
+}
+
+WordMatch StatTrie::match (string_view word) const {
+    // the root keeps no count of its own; every inserted word passes through it
+    WordMatch result { 0, 0, countInsertedWords, 0, nodeEntropy (root, countInsertedWords) };
+    const Node* ptr = root;
+    bool known = true;
+
+    if (symbols) {
+        size_t i = 0;
+        for (string_view token; !(token = SymbolTable::nextToken (word, i)).empty(); ) {
+            ++result.length;
+            if (known) {
+                Symbol id = symbols->find (token);
+                unordered_map<Symbol, Node*>::const_iterator it = ptr->children.find (id);
+                if (id == SymbolTable::npos || it == ptr->children.end()) known = false;
+                else {
+                    ptr = it->second;
+                    ++result.depth;
+                }
+            }
+        }
+    }
+    else {
+        result.length = word.size();
+        for (size_t i = 0; ; ++i) {
+            if (ptr->bucket) {
+                matchContainer (ptr, word.substr (i), result);
+                return result;
+            }
+            if (i == word.size()) break;
+            unordered_map<Symbol, Node*>::const_iterator it = ptr->children.find (toSymbol(word[i]));
+            if (it == ptr->children.end()) {
+                known = false;
+                break;
+            }
+            ptr = it->second;
+            ++result.depth;
+        }
+    }
+
+    if (ptr == root) return result;
+    result.count = ptr->count;
+    result.endCount = known ? ptr->endCount : 0;
+    result.entropy = nodeEntropy (ptr, ptr->count);
+    return result;
+}
+
+void StatTrie::traverse (const Subtree &subtree, function<void(const Node*, const string&)> callback) const {
+    string prefix = subtree.prefix;
+    _traverse (callback, subtree.node, prefix);
+}
+
+void StatTrie::partition (unsigned maxCount, size_t maxSubtrees, vector<Subtree> &heads, vector<Subtree> &subtrees) const {
+    heads.clear();
+    subtrees.assign (1, Subtree { root, "" });
+
+    // max-heap of subtree indices by count; a chain of single children only moves the cut down,
+    // so the number of splits is bounded as well
+    auto lighter = [&](size_t a, size_t b) { return subtrees[a].node->count < subtrees[b].node->count; };
+    vector<size_t> heap { 0 };
+    vector<bool> split (1, false);
+    size_t splits = 0;
+    while (!heap.empty() && subtrees.size() - splits < maxSubtrees && splits < 4 * maxSubtrees) {
+        pop_heap (heap.begin(), heap.end(), lighter);
+        size_t top = heap.back();
+        heap.pop_back();
+        const Node* node = subtrees[top].node;
+        if (node->count <= maxCount) break;
+        if (node->bucket || node->children.empty()) continue; // kept whole
+
+        heads.push_back (subtrees[top]);
+        split[top] = true;
+        ++splits;
+        for (const pair<const Symbol, Node*> &p : node->children) {
+            string prefix = subtrees[top].prefix;
+            appendKey (prefix, p.first);
+            subtrees.push_back (Subtree { p.second, move(prefix) });
+            split.push_back (false);
+            heap.push_back (subtrees.size() - 1);
+            push_heap (heap.begin(), heap.end(), lighter);
+        }
+    }
+
+    size_t kept = 0;
+    for (size_t i = 0; i < subtrees.size(); ++i)
+        if (!split[i]) subtrees[kept++] = move(subtrees[i]);
+    subtrees.resize (kept);
+
+    auto byPrefix = [](const Subtree &a, const Subtree &b) { return a.prefix < b.prefix; };
+    sort (heads.begin(), heads.end(), byPrefix);
+    sort (subtrees.begin(), subtrees.end(), byPrefix);
+}
+
+// Node of prefix, or the container node holding it; nullptr if the prefix is not in the trie
+const Node* StatTrie::locate (const string &prefix) const {
+    const Node* ptr = root;
+    vector<Symbol> keys;
+    if (symbols) {
+        if (!splitTokens (prefix, keys, false)) return nullptr;
+    }
+    else for (char c : prefix) keys.push_back (toSymbol(c));
+
+    for (size_t i = 0; i < keys.size(); ++i) {
+        if (ptr->bucket) return ptr->bucket->hasPrefix (string_view(prefix).substr(i)) ? ptr : nullptr;
+        unordered_map<Symbol, Node*>::const_iterator it = ptr->children.find (keys[i]);
+        if (it == ptr->children.end()) return nullptr;
+        ptr = it->second;
+    }
+    return ptr;
+}
+
+// Children JSON of the virtual subtree spelled by container entries[lo, hi) at depth
+json StatTrie::containerJSON (const ContainerEntries &entries, size_t lo, size_t hi, size_t depth, bool trim, unsigned &id) const {
+    json jChildren = json::object();
+    vector<ContainerGroup> groups;
+    groupContainerRange (entries, lo, hi, depth, groups);
+
+    for (const ContainerGroup &g : groups) {
+        json cj;
+        cj["id"] = id++;
+        if (trim) {
+            cj["label"] = "...";
+            cj["children"] = json::object();
+        }
+        else {
+            cj["label"] = string(1, g.c);
+            cj["children"] = containerJSON (entries, g.lo, g.hi, depth + 1, false, id);
+        }
+        cj["isEnd"] = entries[g.lo].first.size() == depth + 1;
+        cj["count"] = g.count;
+        cj["color"] = "black";
+        jChildren[string(1, g.c)] = move(cj);
+    }
+    return jChildren;
+}
+
 json StatTrie::toPartialJSON(const Node* root, const unordered_set<const Node*> &trimNodes, bool &containTrimNode, unsigned &id) const {
     
     if (!root) return json::object(); // guard
@@ -204,7 +779,7 @@ json StatTrie::toPartialJSON(const Node* root, const unordered_set<const Node*>
         json cj = toPartialJSON(child, trimNodes, childContain, id);
 
         if (childContain) {
-            cj["label"] = string(1, ch);
+            cj["label"] = keyLabel(ch);
             subContain = true;
         }
         else {
@@ -213,7 +788,11 @@ json StatTrie::toPartialJSON(const Node* root, const unordered_set<const Node*>
             cj["children"] = json::object();
         }
 
-        jChildren[string(1, ch)] = move(cj);
+        jChildren[keyLabel(ch)] = move(cj);
+    }
+    if (root->bucket) {
+        ContainerEntries entries = root->bucket->sortedEntries();
+        jChildren = containerJSON (entries, 0, entries.size(), 0, true, id);
     }
 
     bool isTrim = trimNodes.count(root);
@@ -255,8 +834,13 @@ json StatTrie::toJSON(const Node* root, const unordered_set<const Node*> &anomal
 
     for (auto& [ch, child] : root->children) {
         json cj = toJSON(child, anomalyNodes, id);
-        cj["label"] = string(1, ch);
-        jChildren[string(1, ch)] = move(cj);
+        string label = keyLabel(ch);
+        cj["label"] = label;
+        jChildren[label] = move(cj);
+    }
+    if (root->bucket) {
+        ContainerEntries entries = root->bucket->sortedEntries();
+        jChildren = containerJSON (entries, 0, entries.size(), 0, false, id);
     }
 
     bool isAnomaly = anomalyNodes.count(root);
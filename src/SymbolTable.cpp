@@ -0,0 +1,89 @@
+#include "SymbolTable.h"
+using namespace std;
+
+
+/* ---------- CONSTRUCTORS ---------- */
+
+SymbolTable::SymbolTable() {
+    clear();
+}
+
+
+/* ---------- HELPERS ---------- */
+
+// FNV-1a
+uint64_t SymbolTable::hash (string_view token) {
+    uint64_t h = 1469598103934665603ULL;
+    for (char c : token) {
+        h ^= (unsigned char)c;
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+// Index of the slot holding token, or of the empty slot where it would be placed
+size_t SymbolTable::findSlot (string_view token) const {
+    const size_t mask = slots.size() - 1;
+    size_t i = hash(token) & mask;
+    while (slots[i] != npos && lookup(slots[i]) != token) i = (i + 1) & mask;
+    return i;
+}
+
+void SymbolTable::grow() {
+    vector<Symbol> old (slots.size() * 2, npos);
+    old.swap (slots);
+    const size_t mask = slots.size() - 1;
+    for (Symbol id : old) {
+        if (id == npos) continue;
+        size_t i = hash(lookup(id)) & mask;
+        while (slots[i] != npos) i = (i + 1) & mask;
+        slots[i] = id;
+    }
+}
+
+
+/* ---------- BASIC METHODS ---------- */
+
+Symbol SymbolTable::intern (string_view token) {
+    size_t i = findSlot (token);
+    if (slots[i] != npos) return slots[i];
+
+    Symbol id = size();
+    pool.append (token.data(), token.size());
+    offsets.push_back (pool.size());
+    slots[i] = id;
+
+    // keep load factor below 1/2
+    if (2 * size() > slots.size()) grow();
+    return id;
+}
+
+Symbol SymbolTable::find (string_view token) const {
+    return slots[findSlot(token)];
+}
+
+string_view SymbolTable::lookup (Symbol id) const {
+    return string_view (pool.data() + offsets[id], offsets[id+1] - offsets[id]);
+}
+
+size_t SymbolTable::size() const {
+    return offsets.size() - 1;
+}
+
+string_view SymbolTable::nextToken (string_view line, size_t &i) {
+    size_t n = line.size();
+    while (i < n && (line[i] == ' ' || line[i] == '\t')) ++i;
+    size_t start = i;
+    while (i < n && line[i] != ' ' && line[i] != '\t') ++i;
+    return line.substr (start, i - start);
+}
+
+size_t SymbolTable::memoryUsage() const {
+    return pool.capacity() + offsets.capacity() * sizeof(uint32_t) + slots.capacity() * sizeof(Symbol);
+}
+
+void SymbolTable::clear() {
+    pool.clear();
+    offsets.assign (1, 0);
+    slots.assign (64, npos);
+}
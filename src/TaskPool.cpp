@@ -0,0 +1,85 @@
+#include "TaskPool.h"
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+using namespace std;
+
+
+namespace {
+
+    struct WorkQueue {
+        mutex lock;
+        deque<size_t> tasks;
+    };
+
+    bool popBack (WorkQueue &queue, size_t &task) {
+        lock_guard<mutex> guard (queue.lock);
+        if (queue.tasks.empty()) return false;
+        task = queue.tasks.back();
+        queue.tasks.pop_back();
+        return true;
+    }
+
+    bool stealFront (WorkQueue &queue, size_t &task) {
+        lock_guard<mutex> guard (queue.lock);
+        if (queue.tasks.empty()) return false;
+        task = queue.tasks.front();
+        queue.tasks.pop_front();
+        return true;
+    }
+}
+
+
+/* ---------- CONSTRUCTORS ---------- */
+
+TaskPool::TaskPool (unsigned threads) : countThreads(threads) {
+    if (countThreads == 0) countThreads = max(1u, thread::hardware_concurrency());
+}
+
+
+/* ---------- BASIC METHODS ---------- */
+
+unsigned TaskPool::size() const {
+    return countThreads;
+}
+
+void TaskPool::run (size_t n, const function<void(size_t, unsigned)> &task) const {
+    unsigned workers = (unsigned)min<size_t> (countThreads, n);
+    if (workers <= 1) {
+        for (size_t i = 0; i < n; ++i) task (i, 0);
+        return;
+    }
+
+    // tasks are only taken, never added, so a worker that finds every queue empty is done
+    vector<WorkQueue> queues (workers);
+    for (size_t i = 0; i < n; ++i) queues[i % workers].tasks.push_front (i);
+
+    auto work = [&](unsigned self) {
+        size_t i;
+        for (;;) {
+            bool found = popBack (queues[self], i);
+            for (unsigned k = 1; !found && k < workers; ++k)
+                found = stealFront (queues[(self + k) % workers], i);
+            if (!found) return;
+            task (i, self);
+        }
+    };
+
+    vector<thread> threads;
+    for (unsigned w = 1; w < workers; ++w) threads.emplace_back (work, w);
+    work (0);
+    for (thread &t : threads) t.join();
+}
+
+void TaskPool::forChunks (size_t n, const function<void(size_t, size_t)> &chunk) const {
+    size_t chunks = min<size_t> (n, (size_t)countThreads * 4);
+    if (chunks <= 1) {
+        chunk (0, n);
+        return;
+    }
+    run (chunks, [&](size_t c, unsigned) {
+        chunk (n * c / chunks, n * (c + 1) / chunks);
+    });
+}
@@ -0,0 +1,326 @@
+#include "TemplateMiner.h"
+#include <algorithm>
+#include <cstring>
+using namespace std;
+
+
+namespace {
+
+    const char* const PLACEHOLDERS[5] = { "<num>", "<hex>", "<ip>", "<time>", "<uuid>" };
+
+    bool isDigit (char c) {
+        return c >= '0' && c <= '9';
+    }
+
+    bool isHexDigit (char c) {
+        return isDigit (c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+    }
+
+    char lower (char c) {
+        return c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c;
+    }
+
+    // End of the run of at most limit digits from i
+    size_t digits (string_view s, size_t i, size_t limit = string_view::npos) {
+        size_t start = i;
+        while (i < s.size() && isDigit (s[i]) && i - start < limit) ++i;
+        return i;
+    }
+
+    bool isNumber (string_view s) {
+        size_t i = !s.empty() && (s[0] == '-' || s[0] == '+');
+        size_t j = digits (s, i);
+        if (j == i) return false;
+        if (j < s.size() && s[j] == '.') {
+            size_t k = digits (s, j + 1);
+            if (k == j + 1) return false;
+            j = k;
+        }
+        return j == s.size();
+    }
+
+    bool isHex (string_view s) {
+        if (s.size() > 2 && s[0] == '0' && lower (s[1]) == 'x')
+            return all_of (s.begin() + 2, s.end(), isHexDigit);
+        if (s.size() < 8 || !all_of (s.begin(), s.end(), isHexDigit)) return false;
+        return any_of (s.begin(), s.end(), isDigit) && !all_of (s.begin(), s.end(), isDigit);
+    }
+
+    bool isUUID (string_view s) {
+        if (s.size() != 36) return false;
+        for (size_t i = 0; i < 36; ++i) {
+            bool dash = i == 8 || i == 13 || i == 18 || i == 23;
+            if (dash ? s[i] != '-' : !isHexDigit (s[i])) return false;
+        }
+        return true;
+    }
+
+    // a.b.c.d with an optional :port, or IPv6 (hex groups, "::" or all eight groups)
+    bool isIP (string_view s) {
+        size_t i = 0;
+        bool v4 = true;
+        for (int group = 0; v4 && group < 4; ++group) {
+            if (group > 0 && (i >= s.size() || s[i++] != '.')) {
+                v4 = false;
+                break;
+            }
+            size_t j = digits (s, i, 3);
+            unsigned value = 0;
+            for (size_t k = i; k < j; ++k) value = value * 10 + (s[k] - '0');
+            v4 = j > i && (j == s.size() || !isDigit (s[j])) && value <= 255;
+            i = j;
+        }
+        if (v4) {
+            if (i < s.size() && s[i] == ':') {
+                size_t j = digits (s, i + 1, 5);
+                if (j == i + 1) return false;
+                i = j;
+            }
+            return i == s.size();
+        }
+
+        size_t colons = 0, group = 0;
+        bool hexDigit = false;
+        for (char c : s) {
+            if (c == ':') {
+                ++colons;
+                group = 0;
+            }
+            else if (isHexDigit (c) && ++group <= 4) hexDigit = true;
+            else return false;
+        }
+        return hexDigit && colons >= 2 && (colons == 7 || s.find ("::") != string_view::npos);
+    }
+
+    // hh:mm[:ss][.fraction] from i, then an optional zone (z, +hh:mm, -hhmm)
+    bool clock (string_view s, size_t &i) {
+        size_t j = digits (s, i, 2);
+        if (j == i || j >= s.size() || s[j] != ':') return false;
+        size_t k = digits (s, j + 1, 2);
+        if (k != j + 3) return false;
+        i = k;
+        if (i < s.size() && s[i] == ':') {
+            k = digits (s, i + 1, 2);
+            if (k != i + 3) return false;
+            i = k;
+        }
+        if (i < s.size() && (s[i] == '.' || s[i] == ',')) {
+            k = digits (s, i + 1);
+            if (k == i + 1) return false;
+            i = k;
+        }
+        if (i < s.size() && lower (s[i]) == 'z') ++i;
+        else if (i < s.size() && (s[i] == '+' || s[i] == '-')) {
+            k = digits (s, i + 1, 2);
+            if (k != i + 3) return false;
+            if (k < s.size() && s[k] == ':') ++k;
+            size_t m = digits (s, k, 2);
+            if (m != k + 2) return false;
+            i = m;
+        }
+        return true;
+    }
+
+    // Dates (2024-01-31, 31/01/2024), clock times, or a date and a time joined by 't' or ':'
+    bool isTime (string_view s) {
+        size_t i = 0;
+        size_t a = digits (s, 0, 4);
+        if (a > 0 && a < s.size() && (s[a] == '-' || s[a] == '/')) {
+            char separator = s[a];
+            size_t b = digits (s, a + 1, 2);
+            if (b == a + 1 || b >= s.size() || s[b] != separator) return false;
+            size_t c = digits (s, b + 1, 4);
+            if (c == b + 1) return false;
+            i = c;
+            if (i == s.size()) return true;
+            if (lower (s[i]) != 't' && s[i] != ':') return false;
+            ++i;
+        }
+        return clock (s, i) && i == s.size();
+    }
+
+    // Placeholder index of the class of s among the enabled ones, -1 if none
+    int classify (string_view s, uint8_t masks) {
+        if (s.empty() || (!isDigit (s[0]) && !isHexDigit (s[0]) && s[0] != '-' && s[0] != '+' && s[0] != ':')) return -1;
+        if ((masks & MASK_UUID) && isUUID (s)) return 4;
+        if ((masks & MASK_IP) && isIP (s)) return 2;
+        if ((masks & MASK_TIME) && isTime (s)) return 3;
+        if ((masks & MASK_HEX) && isHex (s)) return 1;
+        if ((masks & MASK_NUMBER) && isNumber (s)) return 0;
+        return -1;
+    }
+
+}
+
+
+/* ---------- CONSTRUCTORS ---------- */
+
+TemplateMiner::TemplateMiner (uint8_t masks, double similarity) : masks(masks), threshold(similarity) {
+    wildcard = symbols.intern ("<*>");
+}
+
+
+/* ---------- HELPERS ---------- */
+
+// Split line into tokens and mask them into masked; a value may sit inside brackets or quotes,
+// or after "key="
+void TemplateMiner::mask (string_view line) {
+    masked.clear();
+    originals.clear();
+    variables.clear();
+    bounds.clear();
+
+    size_t i = 0, n = line.size();
+    while (i < n) {
+        while (i < n && (line[i] == ' ' || line[i] == '\t')) ++i;
+        size_t start = i;
+        while (i < n && line[i] != ' ' && line[i] != '\t') ++i;
+        if (i == start) break;
+        string_view token = line.substr (start, i - start);
+        originals.push_back (token);
+        if (!masked.empty()) masked.push_back (' ');
+        bounds.push_back (masked.size());
+
+        size_t from = token.find ('=') + 1;  // 0 without '='
+        while (from < token.size() && token[from] && strchr ("([{<\"'", token[from])) ++from;
+        size_t to = token.size();
+        while (to > from && token[to - 1] && strchr (")]}>\"',;.:", token[to - 1])) --to;
+        int k = classify (token.substr (from, to - from), masks);
+        if (k < 0) {
+            masked.append (token);
+            variables.emplace_back();
+        }
+        else {
+            masked.append (token.substr (0, from)).append (PLACEHOLDERS[k]).append (token.substr (to));
+            variables.push_back (token.substr (from, to - from));
+        }
+    }
+
+    tokens.clear();
+    for (size_t t = 0; t < bounds.size(); ++t) {
+        size_t end = t + 1 < bounds.size() ? bounds[t + 1] - 1 : masked.size();
+        tokens.push_back (string_view (masked).substr (bounds[t], end - bounds[t]));
+    }
+}
+
+// Leaf of the tree for the tokens in ids, below the branch of their count. Tokens with digits
+// route through <*> as in Drain; so does any token once a branch is full. With create, missing
+// branches are added, otherwise nullptr if there is none.
+TemplateMiner::Branch* TemplateMiner::route (Branch &root, bool create) {
+    Branch* node = &root;
+    for (size_t d = 0; d < TREE_DEPTH && d < tokens.size(); ++d) {
+        Symbol key = any_of (tokens[d].begin(), tokens[d].end(), isDigit) ? wildcard : ids[d];
+        auto it = key == SymbolTable::npos ? node->children.end() : node->children.find (key);
+        if (it == node->children.end()) {
+            if (!create) it = node->children.find (wildcard);
+            else {
+                if (node->children.size() >= MAX_CHILDREN) key = wildcard;
+                it = node->children.find (key);
+                if (it == node->children.end()) it = node->children.emplace (key, make_unique<Branch>()).first;
+            }
+            if (it == node->children.end()) return nullptr;
+        }
+        node = it->second.get();
+    }
+    return node;
+}
+
+
+/* ---------- BASIC METHODS ---------- */
+
+string TemplateMiner::maskLine (string_view line) {
+    mask (line);
+    return masked;
+}
+
+uint32_t TemplateMiner::add (string_view line) {
+    mask (line);
+    size_t n = tokens.size();
+    ids.resize (n);
+    for (size_t i = 0; i < n; ++i) ids[i] = symbols.find (tokens[i]);
+
+    // most similar template of the leaf, the one with more wildcards on a tie
+    Branch &root = byLength[n];
+    Branch* leaf = route (root, false);
+    uint32_t best = UINT32_MAX;
+    double bestSimilarity = -1;
+    size_t bestWildcards = 0;
+    if (leaf) {
+        for (uint32_t c : leaf->clusters) {
+            const vector<Symbol> &t = templates[c];
+            size_t same = 0, wildcards = 0;
+            for (size_t i = 0; i < n; ++i) {
+                if (t[i] == wildcard) ++wildcards;
+                else same += t[i] == ids[i];
+            }
+            double similarity = n ? (double)same / n : 1;
+            if (similarity > bestSimilarity || (similarity == bestSimilarity && wildcards > bestWildcards)) {
+                best = c;
+                bestSimilarity = similarity;
+                bestWildcards = wildcards;
+            }
+        }
+    }
+    if (best != UINT32_MAX && bestSimilarity >= threshold) {
+        vector<Symbol> &t = templates[best];
+        for (size_t i = 0; i < n; ++i) {
+            if (t[i] != ids[i]) t[i] = wildcard;
+        }
+        ++sizes[best];
+        return best;
+    }
+
+    for (size_t i = 0; i < n; ++i) ids[i] = symbols.intern (tokens[i]);
+    leaf = route (root, true);
+    uint32_t id = templates.size();
+    templates.push_back (ids);
+    sizes.push_back (1);
+    leaf->clusters.push_back (id);
+    return id;
+}
+
+void TemplateMiner::parameters (string_view line, uint32_t id, vector<string_view> &values) {
+    mask (line);
+    values.clear();
+    const vector<Symbol> &t = templates[id];
+    for (size_t i = 0; i < tokens.size() && i < t.size(); ++i) {
+        if (t[i] == wildcard) values.push_back (originals[i]);
+        else if (!variables[i].empty()) values.push_back (variables[i]);
+    }
+}
+
+size_t TemplateMiner::size() const {
+    return templates.size();
+}
+
+string TemplateMiner::templateOf (uint32_t id) const {
+    string text;
+    for (Symbol key : templates[id]) {
+        if (!text.empty()) text.push_back (' ');
+        text.append (symbols.lookup (key));
+    }
+    return text;
+}
+
+size_t TemplateMiner::templateSize (uint32_t id) const {
+    return sizes[id];
+}
+
+bool TemplateMiner::parseMasks (const string &names, uint8_t &masks) {
+    masks = 0;
+    size_t i = 0;
+    while (i <= names.size()) {
+        size_t j = names.find (',', i);
+        if (j == string::npos) j = names.size();
+        string name = names.substr (i, j - i);
+        if (name == "num") masks |= MASK_NUMBER;
+        else if (name == "hex") masks |= MASK_HEX;
+        else if (name == "ip") masks |= MASK_IP;
+        else if (name == "time") masks |= MASK_TIME;
+        else if (name == "uuid") masks |= MASK_UUID;
+        else if (name == "all") masks |= MASK_ALL;
+        else if (name != "none") return false;
+        i = j + 1;
+    }
+    return true;
+}
@@ -1,27 +1,51 @@
-#include "Analysis.h"
+#include "AnalysisOptions.h"
+#include "Scorer.h"
+#include "Preprocessor.h"
+#include "LineReader.h"
+#include "LogTail.h"
 #include <iostream>
 #include <fstream>
 #include <string>
 #include <filesystem>
-#include <unordered_set>
 #include <vector>
 #include <cstdlib> // std::stod, std::exit
+#include <chrono>
+#include <memory>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <csignal>
+#include <charconv>
 
 using namespace std;
 
-// Định nghĩa tên file output mặc định cho JSON
-const string FN_JSON_COMPLETE = "complete_trie.json";
-const string FN_JSON_PARTIAL  = "partial_trie.json";
-const string FN_JSON_FREQ     = "frequency_anomalies.json";
-const string FN_JSON_LEN      = "length_anomalies.json";
-const string FN_JSON_ENTROPY  = "entropy_anomalies.json";
-
 void printHelp() {
-    cout << "Usage: analyze <input_file> <output_dir> [flags]\n\n"
+    cout << "Usage: analyze <input_file> <output_dir> [flags]\n"
+         << "<input_file> may be '-' to read standard input.\n\n"
          << "Configuration flags:\n"
          << "  --perc-freq=<val>      Percentile threshold for Frequency (Low, default: 5)\n"
          << "  --perc-len=<val>       Percentile threshold for Length (Low, default: 5)\n"
-         << "  --perc-entropy=<val>   Percentile threshold for Entropy (High, default: 95)\n\n"
+         << "  --perc-entropy=<val>   Percentile threshold for Entropy (High, default: 95)\n"
+         << "  --exact-limit=<n>      Exact percentiles up to n values, streaming sketch beyond (default: " << QuantileSketch::DEFAULT_EXACT_LIMIT << ")\n"
+         << "  --sweep=<f:l:e,...>    After the normal outputs, write report_<f>_<l>_<e>.txt for each percentile triple\n"
+         << "  --dump=<file>          Save the analysis state to a binary file\n"
+         << "  --load                 Treat <input_file> as a file written by --dump and regenerate the outputs from it\n"
+         << "  --top=<n>              Keep only the n rarest anomalies per metric (default: 0, all)\n"
+         << "  --threads=<n>          Worker threads for the analysis (default: 0, one per hardware thread)\n"
+         << "  --counts               <input_file> holds '<line>\\t<count>' rows (bin/preprocess --dedup), each inserted once\n"
+         << "  --tokens               Build the trie over whitespace-separated tokens instead of characters\n"
+         << "  --burst=<n>            Keep sparse subtrees in array-hash containers of up to n suffixes (default: 0, off)\n"
+         << "  --compact              Re-lay nodes out in DFS order after building, report layout before/after\n"
+         << "  --verify-entropy       Check the entropy kernel against the reference formula on every node\n\n"
+         << "Stream mode (NDJSON anomaly records on stdout, messages on stderr):\n"
+         << "  --stream               Score each line as it arrives, then insert it; outputs are written at end of input\n"
+         << "  --refresh=<n>          Refresh thresholds every n lines (default: 10000)\n"
+         << "  --refresh-ms=<ms>      ... or every ms milliseconds, whichever comes first (default: 1000)\n\n"
+         << "Follow mode (until Ctrl-C, then the usual outputs):\n"
+         << "  --follow               Tail <input_file> like tail -F, cleaning and inserting each new line\n"
+         << "  --checkpoint=<file>    Trie and position checkpoint, resumed on restart (default: <output_dir>/follow.checkpoint);\n"
+         << "                         lines since the last snapshot are appended to <file>.log\n"
+         << "  --checkpoint-ms=<ms>   Checkpoint interval (default: 10000)\n\n"
          << "JSON export flags (Outputs saved to <output_dir>):\n"
          << "  --json-complete        Export " << FN_JSON_COMPLETE << "\n"
          << "  --json-partial         Export " << FN_JSON_PARTIAL << " (trimmed)\n"
@@ -32,6 +56,368 @@ void printHelp() {
          << "  --help                 Show this help message\n";
 }
 
+// Write s as a JSON string literal; bytes above 0x7F are passed through
+void writeJSONString(ostream& out, string_view s) {
+    out << '"';
+    for (char c : s) {
+        if (c == '"' || c == '\\') out << '\\' << c;
+        else if ((unsigned char)c < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof escaped, "\\u%04x", (unsigned)c);
+            out << escaped;
+        }
+        else out << c;
+    }
+    out << '"';
+}
+
+// Stream mode: every line is scored against the thresholds of the last refresh, then inserted.
+// The first occurrence of an anomalous line gives one NDJSON record; lines before the first
+// refresh only warm the trie up. Records are flushed whenever the input buffer runs dry, so a
+// record never waits for more input.
+void streamAnomalies(LineReader& in, ostream& events, StatTrie& trie, SymbolTable& symbols, Analysis& a,
+                     bool tokenMode, size_t refreshLines, unsigned refreshMs) {
+    Preprocessor pp;
+    vector<Symbol> tokens;
+    string_view line;
+    unique_ptr<Scorer> scorer;
+    size_t lines = 0, sinceRefresh = 0, records = 0, refreshes = 0;
+    double refreshTotal = 0;
+    vector<float> latency;
+
+    auto start = chrono::steady_clock::now();
+    auto lastRefresh = start;
+    for (;;) {
+        if (!in.lineReady()) events.flush(); // the next read may block
+        if (!in.next(line)) break;
+        auto arrival = chrono::steady_clock::now();
+        ++lines;
+
+        // the view lasts until the next read, past the insert below
+        string_view word = line;
+        if (tokenMode) pp.tokenize(line, symbols, tokens);
+        if (tokenMode ? tokens.empty() : word.empty()) continue;
+
+        if (scorer) {
+            LineScore s = scorer->score(word);
+            if (s.frequency == 0 && s.categories) {
+                string metric;
+                if (s.categories & FREQ_ANOMALY) metric += "frequency/";
+                if (s.categories & LEN_ANOMALY) metric += "length/";
+                if (s.categories & ENTROPY_ANOMALY) metric += "entropy/";
+                metric.pop_back();
+
+                events << "{\"seq\":" << lines << ",\"word\":";
+                writeJSONString(events, word);
+                events << ",\"metric\":\"" << metric << "\""
+                       << ",\"length\":" << s.length
+                       << ",\"lengthFrequency\":" << s.lengthFrequency
+                       << ",\"divergeDepth\":" << s.divergeDepth
+                       << ",\"branchEntropy\":" << s.branchEntropy
+                       << ",\"totalWords\":" << trie.totalInsertedWords() << "}\n";
+                ++records;
+            }
+        }
+        if (tokenMode) trie.insert(tokens);
+        else trie.insert(line);
+
+        auto now = chrono::steady_clock::now();
+        if (++sinceRefresh >= refreshLines || now - lastRefresh >= chrono::milliseconds(refreshMs)) {
+            a.refreshThresholds(&trie);
+            scorer = make_unique<Scorer>(trie, a);
+            lastRefresh = chrono::steady_clock::now();
+            refreshTotal += chrono::duration<double, milli>(lastRefresh - now).count();
+            sinceRefresh = 0;
+            ++refreshes;
+            now = lastRefresh;
+        }
+        latency.push_back(chrono::duration<float, micro>(now - arrival).count());
+    }
+    events.flush();
+
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cerr << "Streamed " << lines << " lines in " << seconds << " s (" << lines / max(seconds, 1e-9) << " lines/s), "
+         << records << " anomaly records, " << refreshes << " threshold refreshes"
+         << " (mean " << (refreshes ? refreshTotal / refreshes : 0) << " ms)" << endl;
+    if (!latency.empty()) {
+        sort(latency.begin(), latency.end());
+        auto percentile = [&](double p) { return latency[min(latency.size() - 1, (size_t)(p / 100 * latency.size()))]; };
+        cerr << "- Latency per line (us): p50 = " << percentile(50) << ", p99 = " << percentile(99)
+             << ", max = " << latency.back() << endl;
+    }
+}
+
+const char CHECKPOINT_MAGIC[8] = { 'T', 'R', 'I', 'E', 'F', 'O', 'L', 2 };
+const char CHECKPOINT_LOG_MAGIC[8] = { 'T', 'R', 'I', 'E', 'D', 'E', 'L', 1 };
+const uint64_t FNV_OFFSET = 1469598103934665603ull;
+
+// Follow checkpoint snapshot: its generation, the position reached in the followed file and every
+// word of the trie with its count, written to a temporary file renamed over the previous snapshot
+bool saveCheckpoint(const string& file, const StatTrie& trie, const TailPosition& position, uint64_t generation) {
+    vector<unsigned> counts;
+    vector<uint32_t> lengths;
+    string pool;
+    trie.traverse([&](const Node* node, const string& prefix) {
+        if (node->countEnd() == 0) return;
+        counts.push_back(node->countEnd());
+        lengths.push_back(prefix.size());
+        pool += prefix;
+    });
+
+    string temporary = file + ".tmp";
+    ofstream out(temporary, ios::binary | ios::trunc);
+    auto put = [&](const void* value, size_t bytes) { out.write((const char*)value, bytes); };
+    uint8_t tokenMode = trie.symbolTable() != nullptr;
+    unsigned burstThreshold = trie.containerThreshold();
+    uint64_t words = counts.size(), poolSize = pool.size();
+    put(CHECKPOINT_MAGIC, sizeof CHECKPOINT_MAGIC);
+    put(&generation, sizeof generation);
+    put(&tokenMode, sizeof tokenMode);
+    put(&burstThreshold, sizeof burstThreshold);
+    put(&position, sizeof position);
+    put(&words, sizeof words);
+    put(counts.data(), words * sizeof(unsigned));
+    put(lengths.data(), words * sizeof(uint32_t));
+    put(&poolSize, sizeof poolSize);
+    put(pool.data(), poolSize);
+    out.close();
+    if (!out || rename(temporary.c_str(), file.c_str()) != 0) {
+        cerr << "[ERROR] Failed to write checkpoint file " << file << endl;
+        return false;
+    }
+    return true;
+}
+
+// Restore a checkpoint snapshot into an empty trie set up like the one that was saved
+bool loadCheckpoint(const string& file, StatTrie& trie, TailPosition& position, uint64_t& generation) {
+    ifstream in(file, ios::binary);
+    auto get = [&](void* value, size_t bytes) { return (bool)in.read((char*)value, bytes); };
+    char magic[sizeof CHECKPOINT_MAGIC];
+    uint8_t tokenMode = 0;
+    unsigned burstThreshold = 0;
+    uint64_t words = 0, poolSize = 0;
+    if (!get(magic, sizeof magic) || memcmp(magic, CHECKPOINT_MAGIC, sizeof magic) != 0) {
+        cerr << "[ERROR] '" << file << "' is not a follow checkpoint" << endl;
+        return false;
+    }
+    get(&generation, sizeof generation);
+    get(&tokenMode, sizeof tokenMode);
+    get(&burstThreshold, sizeof burstThreshold);
+    if (tokenMode != (trie.symbolTable() != nullptr) || burstThreshold != trie.containerThreshold()) {
+        cerr << "[ERROR] Checkpoint " << file << " was written with other --tokens/--burst settings" << endl;
+        return false;
+    }
+    get(&position, sizeof position);
+    get(&words, sizeof words);
+    vector<unsigned> counts(in ? words : 0);
+    vector<uint32_t> lengths(counts.size());
+    get(counts.data(), counts.size() * sizeof(unsigned));
+    get(lengths.data(), lengths.size() * sizeof(uint32_t));
+    get(&poolSize, sizeof poolSize);
+    string pool(in ? poolSize : 0, '\0');
+    get(&pool[0], pool.size());
+    uint64_t total = 0;
+    for (uint32_t length : lengths) total += length;
+    if (!in || total != pool.size()) {
+        cerr << "[ERROR] Checkpoint " << file << " is truncated or corrupt" << endl;
+        return false;
+    }
+    size_t offset = 0;
+    for (size_t i = 0; i < counts.size(); offset += lengths[i++])
+        trie.insert(string_view(pool).substr(offset, lengths[i]), counts[i]);
+    return true;
+}
+
+// FNV-1a over a logged word and its '\n'
+uint64_t hashWord(uint64_t hash, string_view word) {
+    for (unsigned char c : word) hash = (hash ^ c) * 1099511628211ull;
+    return (hash ^ '\n') * 1099511628211ull;
+}
+
+// Checkpoint log, <checkpoint>.log: what changed since the snapshot of the same generation.
+// Every inserted word is appended with its '\n' (words are never empty); a checkpoint appends
+// an empty line, the position reached and the hash of the words since the previous one, which
+// commits them. Starts the log over for generation.
+bool resetCheckpointLog(const string& file, uint64_t generation, ofstream& out, uint64_t& bytes) {
+    if (out.is_open()) out.close();
+    out.open(file, ios::binary | ios::trunc);
+    out.write(CHECKPOINT_LOG_MAGIC, sizeof CHECKPOINT_LOG_MAGIC);
+    out.write((const char*)&generation, sizeof generation);
+    out.flush();
+    bytes = sizeof CHECKPOINT_LOG_MAGIC + sizeof generation;
+    if (!out) {
+        cerr << "[ERROR] Failed to write checkpoint file " << file << endl;
+        return false;
+    }
+    return true;
+}
+
+// Insert the committed words of the log over the snapshot of generation and move position to
+// the last commit; bytes is the length of the log up to it. A log of another generation (left
+// by a compaction stopped half-way) is skipped, bytes 0; anything after the last commit is
+// the end of an interrupted write, and is dropped.
+void replayCheckpointLog(const string& file, uint64_t generation, StatTrie& trie, TailPosition& position, uint64_t& bytes) {
+    bytes = 0;
+    ifstream in(file, ios::binary);
+    char magic[sizeof CHECKPOINT_LOG_MAGIC];
+    uint64_t logGeneration = 0;
+    if (!in.read(magic, sizeof magic) || memcmp(magic, CHECKPOINT_LOG_MAGIC, sizeof magic) != 0
+        || !in.read((char*)&logGeneration, sizeof logGeneration) || logGeneration != generation) return;
+    bytes = in.tellg();
+
+    vector<string> words;
+    uint64_t hash = FNV_OFFSET;
+    string word;
+    while (getline(in, word)) {
+        if (!word.empty()) {
+            if (in.eof()) break; // no '\n': cut short
+            hash = hashWord(hash, word);
+            words.push_back(move(word));
+            continue;
+        }
+        TailPosition reached;
+        uint64_t logged;
+        if (!in.read((char*)&reached, sizeof reached) || !in.read((char*)&logged, sizeof logged) || logged != hash) break;
+        for (const string& w : words) trie.insert(w);
+        words.clear();
+        hash = FNV_OFFSET;
+        position = reached;
+        bytes = in.tellg();
+    }
+}
+
+volatile sig_atomic_t stopFollowing = 0;
+
+void requestStop(int) {
+    stopFollowing = 1;
+}
+
+// Follow mode: every complete line appended to inputFile is cleaned like bin/preprocess does by
+// default and inserted, until SIGINT/SIGTERM. The trie and the position reached are checkpointed
+// every checkpointMs and on stop; an existing checkpoint is resumed from, so no line is inserted
+// twice or skipped across restarts (unless the file was rotated while nothing followed it).
+// A checkpoint only appends the words inserted since the previous one to the checkpoint log
+// (nothing at all if no line came in); once the log outgrows the snapshot, a new snapshot is
+// written and the log started over, so the writes stay proportional to the input.
+bool followLog(const string& inputFile, const string& checkpointFile, unsigned checkpointMs,
+               StatTrie& trie, SymbolTable& symbols, bool tokenMode) {
+    TailPosition resume {};
+    string logFile = checkpointFile + ".log";
+    uint64_t generation = 0, logBytes = 0;
+    bool resuming = filesystem::exists(checkpointFile);
+    if (resuming) {
+        if (!loadCheckpoint(checkpointFile, trie, resume, generation)) return false;
+        replayCheckpointLog(logFile, generation, trie, resume, logBytes);
+        trie.recomputeEntropySums();
+    }
+
+    LogTail tail;
+    if (!tail.open(inputFile, resuming ? &resume : nullptr)) {
+        cerr << "[ERROR] Cannot open input file at '" << inputFile << "'\n";
+        return false;
+    }
+    if (resuming) {
+        cerr << "Resumed from checkpoint " << checkpointFile << ": " << trie.totalInsertedWords() << " words, ";
+        if (tail.position().offset == resume.offset && tail.position().inode == resume.inode)
+            cerr << "input from byte " << resume.offset << endl;
+        else cerr << "input rotated or truncated since, read from its start" << endl;
+    }
+    cerr << "Following " << inputFile << " (" << (tail.polling() ? "polling" : "inotify")
+         << "), checkpoints at " << checkpointFile << "; stop with Ctrl-C" << endl;
+
+    struct sigaction action {}, previousInt {}, previousTerm {};
+    action.sa_handler = requestStop; // no SA_RESTART: a signal ends the wait at once
+    sigaction(SIGINT, &action, &previousInt);
+    sigaction(SIGTERM, &action, &previousTerm);
+
+    // a log left by this snapshot goes on after its last commit, any other one starts over
+    ofstream log;
+    uint64_t snapshotBytes = resuming ? filesystem::file_size(checkpointFile) : 0;
+    bool ok = true;
+    if (!resuming) ok = saveCheckpoint(checkpointFile, trie, tail.position(), generation);
+    if (ok && logBytes > 0) {
+        filesystem::resize_file(logFile, logBytes);
+        log.open(logFile, ios::binary | ios::app);
+        ok = log.is_open();
+    }
+    else if (ok) ok = resetCheckpointLog(logFile, generation, log, logBytes);
+
+    Preprocessor pp;
+    string cleaned;
+    vector<Symbol> tokens;
+    size_t lines = 0, checkpoints = 0, snapshots = 0, logged = 0;
+    uint64_t hash = FNV_OFFSET;
+    TailPosition committed = tail.position();
+    auto start = chrono::steady_clock::now();
+    auto lastCheckpoint = start;
+    auto checkpoint = [&]() {
+        TailPosition reached = tail.position();
+        lastCheckpoint = chrono::steady_clock::now();
+        if (logged == 0 && memcmp(&reached, &committed, sizeof reached) == 0) return;
+        if (logBytes > snapshotBytes) {
+            ok = saveCheckpoint(checkpointFile, trie, reached, ++generation)
+              && resetCheckpointLog(logFile, generation, log, logBytes);
+            snapshotBytes = ok ? filesystem::file_size(checkpointFile) : 0;
+            ++snapshots;
+        }
+        else {
+            log.put('\n');
+            log.write((const char*)&reached, sizeof reached);
+            log.write((const char*)&hash, sizeof hash);
+            log.flush();
+            logBytes += 1 + sizeof reached + sizeof hash;
+            if (!log) {
+                cerr << "[ERROR] Failed to write checkpoint file " << logFile << endl;
+                ok = false;
+            }
+        }
+        committed = reached;
+        logged = 0;
+        hash = FNV_OFFSET;
+        ++checkpoints;
+    };
+
+    while (ok && !stopFollowing) {
+        string_view line;
+        while (!stopFollowing && tail.next(line)) {
+            // delimiters may cut one input line into several cleaned lines
+            pp.cleanLine(line, cleaned);
+            for (size_t i = 0; i < cleaned.size(); ) {
+                size_t end = cleaned.find('\n', i);
+                if (end == string::npos) end = cleaned.size();
+                string_view word(cleaned.data() + i, end - i);
+                i = end + 1;
+                if (word.empty()) continue;
+                log << word << '\n';
+                logBytes += word.size() + 1;
+                hash = hashWord(hash, word);
+                ++logged;
+                if (tokenMode) {
+                    pp.tokenize(word, symbols, tokens);
+                    trie.insert(tokens);
+                }
+                else trie.insert(word);
+            }
+            if (++lines % 4096 == 0 && chrono::steady_clock::now() - lastCheckpoint >= chrono::milliseconds(checkpointMs)) break;
+        }
+        auto elapsed = chrono::steady_clock::now() - lastCheckpoint;
+        if (elapsed >= chrono::milliseconds(checkpointMs)) checkpoint();
+        else if (!stopFollowing) {
+            long long left = checkpointMs - chrono::duration_cast<chrono::milliseconds>(elapsed).count();
+            tail.wait(min(left, 1000ll));
+        }
+    }
+    if (ok) checkpoint();
+    sigaction(SIGINT, &previousInt, nullptr);
+    sigaction(SIGTERM, &previousTerm, nullptr);
+
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cerr << "Followed " << lines << " new lines in " << seconds << " s, " << tail.totalRotations() << " rotations, "
+         << tail.totalTruncations() << " truncations, " << checkpoints << " checkpoints (" << snapshots << " snapshots), stopped at byte "
+         << tail.position().offset << endl;
+    return ok;
+}
+
 // Hàm tiện ích kiểm tra tiền tố chuỗi
 bool startsWith(const string& str, const string& prefix) {
     return str.size() >= prefix.size() && 
@@ -57,7 +443,8 @@ int main(int argc, char *argv[]) {
     string outputDir = argv[2];
 
     /* Check paths' existence */
-    if (!filesystem::exists(inputFile)) {
+    bool fromStdin = inputFile == "-";
+    if (!fromStdin && !filesystem::exists(inputFile)) {
         cerr << "[ERROR] Input file '" <<  inputFile << "' does not exist" << endl;
         return 1;
     }
@@ -66,132 +453,144 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 
-    ifstream fin (inputFile);
-    if (!fin.is_open()) {
-        cerr << "[ERROR] Cannot open input file at '" << inputFile << "'\n";
-        return 1;
-    }
-
     /* --- Configuration Variables (Default Values) --- */
-    // Mặc định: 5 (freq thấp), 5 (len thấp), 95 (entropy cao)
-    double valPercFreq = 5.0;
-    double valPercLen = 5.0;
-    double valPercEntropy = 95.0;
-
-    /* --- JSON Flags (Booleans) --- */
-    bool doJsonComplete = false;
-    bool doJsonPartial  = false;
-    bool doJsonFreq     = false;
-    bool doJsonLen      = false;
-    bool doJsonEntropy  = false;
+    // analysis flags (percentiles, trie mode, dump, sweep, JSON exports) go to options
+    AnalysisOptions options;
+    bool loadDump = false;
+    bool doStream = false;
+    size_t refreshLines = 10000;
+    unsigned refreshMs = 1000;
+    bool doFollow = false;
+    string checkpointFile;
+    unsigned checkpointMs = 10000;
+
+    bool countedInput = false;
 
     /* --- Parse Flags --- */
     for (int i = 3; i < argc; i++) {
         string arg = argv[i];
 
-        // 1. Parsing Percentile Flags (Value flags)
-        if (startsWith(arg, "--perc-freq=")) {
+        int taken = options.parse(arg);
+        if (taken < 0) return 1;
+        if (taken) continue;
+
+        if (arg == "--load")               loadDump = true;
+        else if (arg == "--stream")        doStream = true;
+        else if (startsWith(arg, "--refresh=")) {
             try {
-                valPercFreq = stod(arg.substr(12)); // Length of "--perc-freq=" is 12
+                refreshLines = max(1ul, stoul(arg.substr(10))); // Length of "--refresh=" is 10
             } catch (...) {
-                cerr << "[ERROR] Invalid value for --perc-freq: " << arg << endl;
+                cerr << "[ERROR] Invalid value for --refresh: " << arg << endl;
                 return 1;
             }
         }
-        else if (startsWith(arg, "--perc-len=")) {
+        else if (startsWith(arg, "--refresh-ms=")) {
             try {
-                valPercLen = stod(arg.substr(11)); // Length of "--perc-len=" is 11
+                refreshMs = stoul(arg.substr(13)); // Length of "--refresh-ms=" is 13
             } catch (...) {
-                cerr << "[ERROR] Invalid value for --perc-len: " << arg << endl;
+                cerr << "[ERROR] Invalid value for --refresh-ms: " << arg << endl;
                 return 1;
             }
         }
-        else if (startsWith(arg, "--perc-entropy=")) {
+        else if (arg == "--follow")        doFollow = true;
+        else if (startsWith(arg, "--checkpoint=")) checkpointFile = arg.substr(13); // Length of "--checkpoint=" is 13
+        else if (startsWith(arg, "--checkpoint-ms=")) {
             try {
-                valPercEntropy = stod(arg.substr(15)); // Length of "--perc-entropy=" is 15
+                checkpointMs = max(1ul, stoul(arg.substr(16))); // Length of "--checkpoint-ms=" is 16
             } catch (...) {
-                cerr << "[ERROR] Invalid value for --perc-entropy: " << arg << endl;
+                cerr << "[ERROR] Invalid value for --checkpoint-ms: " << arg << endl;
                 return 1;
             }
         }
-        // 2. Parsing JSON Export Flags (Boolean flags)
-        else if (arg == "--json-complete") doJsonComplete = true;
-        else if (arg == "--json-partial")  doJsonPartial = true;
-        else if (arg == "--json-freq")     doJsonFreq = true;
-        else if (arg == "--json-len")      doJsonLen = true;
-        else if (arg == "--json-entropy")  doJsonEntropy = true;
+        else if (arg == "--counts")        countedInput = true;
         else {
             cerr << "[ERROR] Invalid flag: " << arg << "\nRun 'analyze --help' for usage info\n";
             return 1;
         }
     }
 
-    // cout << valPercFreq << ' ' << valPercLen << ' ' << valPercEntropy << endl;
-    // return 0;
-
-    /* Build trie */
+    /* Build and analyze trie, or restore a dumped analysis */
     StatTrie trie;
-    string line;
-    while (getline(fin, line)) trie.insert(line);
-
-    /* Analyze trie */
-    Analysis a(valPercFreq, valPercLen, valPercEntropy);
-    a.collectStatistics(&trie);
-
-    /* Output Reports & CSV */
-    
-    a.exportReport(outputDir + "/overall_report.txt");
-
-    a.exportCSV(outputDir + "/all_entries.csv");
-    // Sử dụng ký tự hằng số 'f', 'l', 'e' như code cũ (hoặc hằng số nếu đã define)
-    a.exportCSV(outputDir + "/frequency_anomalies.csv", 'f');
-    a.exportCSV(outputDir + "/length_anomalies.csv", 'l');
-    a.exportCSV(outputDir + "/entropy_anomalies.csv", 'e');
-
-
-    /* Output JSONs */
-    // Logic mới: Sử dụng bool flags và đường dẫn cố định
-    
-    // 1. Complete & Partial (Dùng chung set anomaly tổng hợp)
-    if (doJsonComplete || doJsonPartial) {
-        unordered_set<const Node*> allAbnormalNodes;
-        a.markAnomalyNodes(allAbnormalNodes); // Mặc định là mark all types
-
-        if (doJsonComplete) {
-            string path = outputDir + "/" + FN_JSON_COMPLETE;
-            trie.exportAllJSON(path, allAbnormalNodes);
-        }
-        if (doJsonPartial) {
-            string path = outputDir + "/" + FN_JSON_PARTIAL;
-            trie.exportPartialJSON(path, allAbnormalNodes);
-        }
-    }
+    SymbolTable symbols;
+    Analysis a(options.percFreq, options.percLen, options.percEntropy);
+    options.configure(a);
 
-    // 2. Frequency Anomalies Only
-    if (doJsonFreq) {
-        unordered_set<const Node*> freqNodes;
-        a.markAnomalyNodes(freqNodes, 'f');
-        string path = outputDir + "/" + FN_JSON_FREQ;
-        trie.exportPartialJSON(path, freqNodes);
+    if (doStream && loadDump) {
+        cerr << "[ERROR] --stream cannot be combined with --load" << endl;
+        return 1;
     }
-
-    // 3. Length Anomalies Only
-    if (doJsonLen) {
-        unordered_set<const Node*> lenNodes;
-        a.markAnomalyNodes(lenNodes, 'l');
-        string path = outputDir + "/" + FN_JSON_LEN;
-        trie.exportPartialJSON(path, lenNodes);
+    if (countedInput && (doStream || doFollow || loadDump)) {
+        cerr << "[ERROR] --counts cannot be combined with --stream, --follow or --load" << endl;
+        return 1;
+    }
+    if (doFollow && (doStream || loadDump || fromStdin)) {
+        cerr << "[ERROR] --follow needs an input file and cannot be combined with --stream or --load" << endl;
+        return 1;
+    }
+    if (checkpointFile.empty()) checkpointFile = outputDir + "/follow.checkpoint";
+    // stream mode: records go to the real stdout, every other message to stderr
+    ostream events (nullptr);
+    if (doStream) {
+        ios::sync_with_stdio(false); // records are buffered, flushed when the input runs dry
+        events.rdbuf(cout.rdbuf());
+        cout.rdbuf(cerr.rdbuf());
     }
 
-    // 4. Entropy Anomalies Only
-    if (doJsonEntropy) {
-        unordered_set<const Node*> entropyNodes;
-        a.markAnomalyNodes(entropyNodes, 'e');
-        string path = outputDir + "/" + FN_JSON_ENTROPY;
-        trie.exportPartialJSON(path, entropyNodes);
+    if (loadDump) {
+        // <input_file> is a dump written by --dump; settings come from the dump
+        if (!a.load(inputFile)) return 1;
+        if (options.wantsJSON()) a.rebuildTrie(trie, symbols);
+        return exportAnalysis(options, trie, a, outputDir) ? 0 : 1;
     }
 
-    return 0;
+    if (!options.configure(trie, symbols)) return 1;
+    bool tokenMode = options.tokenMode;
+    if (doStream) {
+        // lines arrive block by block from a pipe or stdin, decompressed if need be
+        LineReader reader;
+        if (!reader.open(inputFile)) {
+            cerr << "[ERROR] Cannot read input file at '" << inputFile << "'\n";
+            return 1;
+        }
+        streamAnomalies(reader, events, trie, symbols, a, tokenMode, refreshLines, refreshMs);
+    }
+    else if (doFollow) {
+        if (!followLog(inputFile, checkpointFile, checkpointMs, trie, symbols, tokenMode)) return 1;
+    }
+    else {
+        // lines are views into the mapped input, inserted without copies
+        LineReader reader;
+        if (!reader.open(inputFile)) {
+            cerr << "[ERROR] Cannot read input file at '" << inputFile << "'\n";
+            return 1;
+        }
+        string_view line;
+        Preprocessor pp;
+        vector<Symbol> tokens;
+        unsigned count = 1;
+        size_t row = 0;
+        while (reader.next(line)) {
+            ++row;
+            if (countedInput) {
+                // "<line>\t<count>": one trie walk for all the occurrences of a line
+                size_t tab = line.rfind('\t');
+                const char* end = line.data() + line.size();
+                if (tab == string_view::npos || from_chars(line.data() + tab + 1, end, count).ptr != end || count == 0) {
+                    cerr << "[ERROR] Row " << row << " of '" << inputFile << "' is not '<line>\\t<count>'" << endl;
+                    return 1;
+                }
+                line = line.substr(0, tab);
+            }
+            if (tokenMode) {
+                // Token mode: each line is split into interned tokens, trie depth = token count
+                pp.tokenize(line, symbols, tokens);
+                trie.insert(tokens, count);
+            }
+            else trie.insert(line, count);
+        }
+        if (countedInput) trie.recomputeEntropySums();
+    }
+    return runAnalysis(options, trie, a, outputDir) ? 0 : 1;
 }
 
-// Compile: g++ -std=c++17 -Iinclude -o bin/analyze src/analyze.cpp src/Analysis.cpp src/StatTrie.cpp
\ No newline at end of file
+// Compile: g++ -std=c++17 -pthread -Iinclude -o bin/analyze src/analyze.cpp src/Analysis.cpp src/AnalysisOptions.cpp src/Scorer.cpp src/StatTrie.cpp src/ArrayHash.cpp src/Entropy.cpp src/QuantileSketch.cpp src/TaskPool.cpp src/Preprocessor.cpp src/TemplateMiner.cpp src/Regex.cpp src/SymbolTable.cpp src/LineReader.cpp src/LogTail.cpp -lz
\ No newline at end of file
@@ -4,6 +4,9 @@
 #include <cstdlib>
 #include <sstream>
 #include <cstring> // For strncmp
+#include <fstream>
+#include "Preprocessor.h"
+#include "AnalysisOptions.h"
 
 // Structure to store visualization tasks
 struct VisualTask {
@@ -36,11 +39,27 @@ void print_help(const char* prog_name) {
               << "PREPROCESSING FLAGS:\n"
               << "  --regex=\"...\"       : Filter strings using Regex (Highest priority)\n"
               << "  --delim=\"...\"       : Delimiter characters (Default if no regex)\n"
-              << "  --ignore=\"...\"      : Characters to ignore (Default if no regex)\n\n"
+              << "  --ignore=\"...\"      : Characters to ignore (Default if no regex)\n"
+              << "  --regex-engine=<e>  : dfa (built-in automata, default) or std (std::regex)\n"
+              << "  --templates         : Insert mined log templates instead of cleaned lines (not with --regex)\n"
+              << "  --mask=<classes>    : Tokens masked before mining: num,hex,ip,time,uuid, all (default) or none\n"
+              << "  --template-sim=<s>  : Share of equal tokens for a line to join a template (default: 0.5)\n"
+              << "  --dedup             : Insert each distinct line once with its count (cleaned_data.txt holds\n"
+              << "                        '<line>\\t<count>' rows then)\n"
+              << "  --keep-cleaned      : Also write cleaned_data.txt (always written with --spawn)\n\n"
               << "ANALYZE FLAGS:\n"
               << "  --perc-freq=<val>      Percentile threshold for Frequency (Low, default: 5)\n"
               << "  --perc-len=<val>       Percentile threshold for Length (Low, default: 5)\n"
-              << "  --perc-entropy=<val>   Percentile threshold for Entropy (High, default: 95)\n\n"
+              << "  --perc-entropy=<val>   Percentile threshold for Entropy (High, default: 95)\n"
+              << "  --exact-limit=<n>      Exact percentiles up to n values, streaming sketch beyond\n"
+              << "  --sweep=<f:l:e,...>    Also write one report per percentile triple\n"
+              << "  --dump=<file>          Save the analysis state (reload with: bin/analyze <file> <output_dir> --load)\n"
+              << "  --top=<n>              Keep only the n rarest anomalies per metric\n"
+              << "  --threads=<n>          Worker threads for the analysis (0: one per hardware thread)\n"
+              << "  --tokens               Build the trie over tokens instead of characters\n"
+              << "  --burst=<n>            Burst-trie containers of up to n suffixes (character trie only)\n"
+              << "  --compact              Re-lay trie nodes out in DFS order before analysis\n"
+              << "  --verify-entropy       Check the entropy kernel against the reference formula first\n\n"
               << "VISUALIZATION FLAGS:\n"
               << "  --visual-complete   : Visualize the complete Trie\n"
               << "  --visual-partial    : Visualize partial Trie (show anomalies only)\n"
@@ -48,6 +67,8 @@ void print_help(const char* prog_name) {
               << "  --visual-len        : Visualize length anomalies\n"
               << "  --visual-entropy    : Visualize entropy anomalies\n"
               << "\nOTHER FLAGS:\n"
+              << "  --spawn             : Run bin/preprocess and bin/analyze as separate processes through\n"
+              << "                        cleaned_data.txt instead of in this process\n"
               << "  --help              : Show this help message\n";
 }
 
@@ -73,11 +94,18 @@ int main(int argc, char* argv[]) {
     std::string pp_regex = "";
     std::string pp_delim = "";
     std::string pp_ignore = "";
+    std::string pp_regex_engine = "";
+    bool pp_templates = false;
+    std::string pp_mask = "";
+    std::string pp_template_sim = "";
+    bool pp_dedup = false;
 
-    // Variables for Analyze configuration
-    std::string ana_perc_freq = "";
-    std::string ana_perc_len = "";
-    std::string ana_perc_entropy = "";
+    // Analyze configuration, shared with bin/analyze
+    AnalysisOptions ana;
+
+    // Pipeline mode
+    bool spawn = false;
+    bool keep_cleaned = false;
 
     // Variables for Visualize configuration
     bool vis_complete = false;
@@ -90,8 +118,19 @@ int main(int argc, char* argv[]) {
     for (int i = 3; i < argc; ++i) {
         std::string arg = argv[i];
 
-        // 1. Capture Preprocess flags
+        // 1. Capture Analyze flags
+        int taken = ana.parse(arg);
+        if (taken < 0) return 1;
+        if (taken) continue;
+
+        // 2. Capture Preprocess flags
         if (starts_with(arg, "--regex=")) {
+            if (!pp_regex.empty()) {
+                // one trie per run: several patterns are split with bin/preprocess first
+                std::cerr << "[ERROR] Only one --regex per pipeline; extract several patterns in one pass with "
+                          << "bin/preprocess <input> <output> --regex=... --regex=..." << std::endl;
+                return 1;
+            }
             pp_regex = arg.substr(8); // Get value after '='
         }
         else if (starts_with(arg, "--delim=")) {
@@ -100,16 +139,19 @@ int main(int argc, char* argv[]) {
         else if (starts_with(arg, "--ignore=")) {
             pp_ignore = arg.substr(9);
         }
-        // 2. Capture Analyze flags
-        else if (starts_with(arg, "--perc-freq=")) {
-            ana_perc_freq = arg.substr(12);
+        else if (starts_with(arg, "--regex-engine=")) {
+            pp_regex_engine = arg.substr(15);
         }
-        else if (starts_with(arg, "--perc-len=")) {
-            ana_perc_len = arg.substr(11);
+        else if (arg == "--templates") pp_templates = true;
+        else if (arg == "--dedup") pp_dedup = true;
+        else if (starts_with(arg, "--mask=")) {
+            pp_mask = arg.substr(7);
         }
-        else if (starts_with(arg, "--perc-entropy=")) {
-            ana_perc_entropy= arg.substr(15);
+        else if (starts_with(arg, "--template-sim=")) {
+            pp_template_sim = arg.substr(15);
         }
+        else if (arg == "--spawn") spawn = true;
+        else if (arg == "--keep-cleaned") keep_cleaned = true;
         // 3. Capture Visualize flags
         else if (arg == "--visual-complete") vis_complete = true;
         else if (arg == "--visual-partial") vis_partial = true;
@@ -126,59 +168,175 @@ int main(int argc, char* argv[]) {
     std::string mkdir_cmd = "mkdir -p \"" + output_dir + "\"";
     std::system(mkdir_cmd.c_str());
 
-    // --- STEP 1: PREPROCESS ---
     std::string cleaned_input = output_dir + "/cleaned_data.txt";
-    std::stringstream pp_cmd;
-    
-    // Base command
-    pp_cmd << "bin/preprocess \"" << input_text << "\" \"" << cleaned_input << "\"";
+    std::vector<VisualTask> tasks;
 
-    // Priority logic: Regex > Delim/Ignore
-    if (!pp_regex.empty()) {
-        // Regex mode
-        pp_cmd << " --regex=\"" << pp_regex << "\""; 
-    } else {
-        // Default mode (Delim/Ignore)
-        if (!pp_delim.empty())  pp_cmd << " --delim=\"" << pp_delim << "\"";
-        if (!pp_ignore.empty()) pp_cmd << " --ignore=\"" << pp_ignore << "\"";
-    }
+    // Helper lambda to add tasks; the analysis step writes the JSON, visualize draws it
+    auto addTask = [&](const std::string& flag, const std::string& json_name) {
+        ana.parse(flag);
+        std::string json = output_dir + "/" + json_name;
+        std::string png = json.substr(0, json.size() - 5) + ".png"; // ".json" -> ".png"
+        tasks.push_back({json, png});
+    };
 
-    // std::cout << pp_cmd.str() << std::endl;
-    run_command("Preprocess Module", pp_cmd.str());
+    if (vis_complete) addTask("--json-complete", FN_JSON_COMPLETE);
+    if (vis_partial)  addTask("--json-partial", FN_JSON_PARTIAL);
+    if (vis_freq)     addTask("--json-freq", FN_JSON_FREQ);
+    if (vis_len)      addTask("--json-len", FN_JSON_LEN);
+    if (vis_entropy)  addTask("--json-entropy", FN_JSON_ENTROPY);
 
-    // --- STEP 2: ANALYZE ---
-    std::stringstream analyze_cmd;
-    analyze_cmd << "bin/analyze \"" << cleaned_input << "\" \"" << output_dir << "\"";
+    if (spawn) {
+        // --- STEP 1: PREPROCESS ---
+        std::stringstream pp_cmd;
 
-    // Percentile
-    if (!ana_perc_freq.empty()) {
-        analyze_cmd << " --perc-freq=" << ana_perc_freq;
-    }
-    if (!ana_perc_len.empty()) {
-        analyze_cmd << " --perc-len=" << ana_perc_len;
-    }
-    if (!ana_perc_entropy.empty()) {
-        analyze_cmd << " --perc-entropy=" << ana_perc_entropy;
+        // Base command
+        pp_cmd << "bin/preprocess \"" << input_text << "\" \"" << cleaned_input << "\"";
+
+        // Priority logic: Regex > Delim/Ignore
+        if (!pp_regex.empty()) {
+            // Regex mode
+            pp_cmd << " --regex=\"" << pp_regex << "\"";
+            if (!pp_regex_engine.empty()) pp_cmd << " --regex-engine=" << pp_regex_engine;
+        } else {
+            // Default mode (Delim/Ignore)
+            if (!pp_delim.empty())  pp_cmd << " --delim=\"" << pp_delim << "\"";
+            if (!pp_ignore.empty()) pp_cmd << " --ignore=\"" << pp_ignore << "\"";
+            if (pp_templates) pp_cmd << " --templates";
+            if (!pp_mask.empty()) pp_cmd << " --mask=" << pp_mask;
+            if (!pp_template_sim.empty()) pp_cmd << " --template-sim=" << pp_template_sim;
+            if (pp_dedup) pp_cmd << " --dedup";
+        }
+
+        // std::cout << pp_cmd.str() << std::endl;
+        run_command("Preprocess Module", pp_cmd.str());
+
+        // --- STEP 2: ANALYZE ---
+        std::stringstream analyze_cmd;
+        analyze_cmd << "bin/analyze \"" << cleaned_input << "\" \"" << output_dir << "\"";
+
+        if (pp_dedup && pp_regex.empty()) {
+            analyze_cmd << " --counts";
+        }
+        for (const std::string& flag : ana.flags) {
+            analyze_cmd << " " << flag;
+        }
+
+        // std::cout << analyze_cmd.str() << std::endl;
+        run_command("Analyze Module", analyze_cmd.str());
     }
-    
-    std::vector<VisualTask> tasks;
+    else {
+        // --- STEP 1+2: PREPROCESS AND ANALYZE IN PROCESS ---
+        // Cleaned lines go straight from the Preprocessor into the trie; the output files are the
+        // same as with --spawn (cleaned_data.txt only with --keep-cleaned)
+        auto fail = [](const std::string& message) {
+            std::cerr << "\n[ERROR] " << message << std::endl;
+            exit(EXIT_FAILURE);
+        };
+        auto number = [&](const std::string& flag, const std::string& value, double fallback) {
+            if (value.empty()) return fallback;
+            try {
+                return std::stod(value);
+            } catch (...) {
+                fail("Invalid value for " + flag + ": " + value);
+            }
+            return fallback;
+        };
 
-    // Helper lambda to add tasks
-    auto addTask = [&](const std::string& flag, const std::string& name) {
-        analyze_cmd << " " << flag;
-        std::string json = output_dir + "/" + name + ".json";
-        std::string png = output_dir + "/" + name + ".png";
-        tasks.push_back({json, png});
-    };
+        std::ofstream cleaned_out;
+        if (keep_cleaned) {
+            cleaned_out.open(cleaned_input);
+            if (!cleaned_out.is_open()) fail("Cannot open output file at '" + cleaned_input + "'");
+        }
 
-    if (vis_complete) addTask("--json-complete", "complete_trie");
-    if (vis_partial)  addTask("--json-partial", "partial_trie");
-    if (vis_freq)     addTask("--json-freq", "frequency_anomalies");
-    if (vis_len)      addTask("--json-len", "length_anomalies");
-    if (vis_entropy)  addTask("--json-entropy", "entropy_anomalies");
+        StatTrie trie;
+        SymbolTable symbols;
+        Preprocessor pp(true);
+        std::vector<Symbol> tokens;
+        if (!ana.configure(trie, symbols)) return 1;
 
-    // std::cout << analyze_cmd.str() << std::endl;
-    run_command("Analyze Module", analyze_cmd.str());
+        // one line of cleaned_data.txt, occurring count times
+        auto insertCounted = [&](std::string_view word, unsigned count) {
+            if (ana.tokenMode) {
+                pp.tokenize(word, symbols, tokens);
+                trie.insert(tokens, count);
+            }
+            else trie.insert(word, count);
+        };
+        // --dedup: lines are counted first, then every distinct one walks the trie once
+        LineCounter counter;
+        bool dedup = pp_dedup && pp_regex.empty();
+        auto insert = [&](std::string_view word) {
+            if (dedup) counter.add(word);
+            else {
+                if (keep_cleaned) cleaned_out << word << '\n';
+                insertCounted(word, 1);
+            }
+        };
+
+        if (!pp_regex_engine.empty() && pp_regex_engine != "dfa" && pp_regex_engine != "std") {
+            fail("Invalid value for --regex-engine: " + pp_regex_engine);
+        }
+        if (pp_regex_engine == "std") pp.setRegexEngine(REGEX_STD);
+
+        if (!pp_regex.empty()) {
+            // captures are lowercased as bin/preprocess writes them (Preprocessor::writeCollected)
+            LineReader reader;
+            if (!reader.open(input_text)) fail("Cannot read input file at '" + input_text + "'");
+            std::string lowered;
+            bool valid = pp.filterByRegex(reader, pp_regex, [&](std::string_view capture) {
+                pp.foldCollected(capture, lowered);
+                insert(lowered);
+            });
+            if (!valid) fail("Invalid regex: " + pp_regex);
+        }
+        else {
+            if (!pp_ignore.empty()) pp.setIgnoredCharacters(pp_ignore);
+            if (!pp_delim.empty()) pp.setDelimiters(pp_delim);
+
+            bool readable;
+            if (pp_templates) {
+                uint8_t masks = MASK_ALL;
+                if (!pp_mask.empty() && !TemplateMiner::parseMasks(pp_mask, masks)) fail("Invalid value for --mask: " + pp_mask);
+                TemplateMiner miner(masks, number("--template-sim", pp_template_sim, 0.5));
+                if (keep_cleaned && !dedup) {
+                    readable = pp.writeTemplates(input_text, miner, cleaned_input + ".spool", insert);
+                }
+                else {
+                    // templates are only final at the end of input: every one is inserted then,
+                    // once with the count of its lines
+                    readable = pp.mineTemplates(input_text, miner, [](uint32_t, std::string_view) {});
+                    for (uint32_t id = 0; readable && id < miner.size(); ++id) {
+                        if (dedup) counter.add(miner.templateOf(id), miner.templateSize(id));
+                        else insertCounted(miner.templateOf(id), miner.templateSize(id));
+                    }
+                }
+            }
+            else {
+                // delimiters turn one input line into several cleaned lines
+                readable = pp.processFile(input_text, [&](std::string_view cleaned) {
+                    size_t begin = 0, end;
+                    while ((end = cleaned.find('\n', begin)) != std::string_view::npos) {
+                        insert(cleaned.substr(begin, end - begin));
+                        begin = end + 1;
+                    }
+                    if (begin < cleaned.size()) insert(cleaned.substr(begin));
+                });
+            }
+            if (!readable) fail("Cannot read input file at '" + input_text + "'");
+        }
+        if (dedup) {
+            if (keep_cleaned) counter.write(cleaned_out);
+            counter.forEach(insertCounted);
+        }
+        if (keep_cleaned) {
+            cleaned_out.close();
+            std::cout << "Cleaned data exported to: " << cleaned_input << std::endl;
+        }
+
+        Analysis a(ana.percFreq, ana.percLen, ana.percEntropy);
+        ana.configure(a);
+        if (!runAnalysis(ana, trie, a, output_dir)) return 1;
+    }
 
     // --- STEP 3: VISUALIZE ---
     if (tasks.empty()) {
@@ -194,4 +352,4 @@ int main(int argc, char* argv[]) {
 
     std::cout << "\nResults at: " << output_dir << std::endl;
     return 0;
-}
\ No newline at end of file
+}
@@ -1,7 +1,12 @@
 #include <iostream>
+#include <fstream>
 #include <string>
 #include <cstring>
+#include <chrono>
+#include <filesystem>
+#include <algorithm>
 #include "Preprocessor.h"
+#include "LineReader.h"
 
 using namespace std;
 
@@ -9,9 +14,20 @@ void displayUsage() {
     std::cerr << "Usage:\n";
     std::cerr << "  ./preprocess <input file> <output file> [flags]\n\n";
     std::cerr << "Flags:\n";
-    std::cerr << "  --regex=<pattern>       : filter using regex \n";
+    std::cerr << "  --regex=<pattern>       : filter using regex; repeat it to extract several patterns in one pass,\n";
+    std::cerr << "                            the k-th into <output stem>.<k><extension>\n";
     std::cerr << "  --ignore=<chars>        : characters to ignore\n";
     std::cerr << "  --delim=<chars>         : delimiter characters\n";
+    std::cerr << "  --regex-engine=<e>      : dfa (built-in automata, default) or std (std::regex)\n";
+    std::cerr << "  --threads=<n>           : clean on n threads, output order kept (0: one per hardware thread);\n";
+    std::cerr << "                            not with --templates or --dedup\n";
+    std::cerr << "  --templates             : write the mined log template of each cleaned line instead of the line (not with --regex)\n";
+    std::cerr << "                            (template ids are spooled to <output>.spool until the templates are final)\n";
+    std::cerr << "  --mask=<classes>        : tokens masked before mining: num,hex,ip,time,uuid, all (default) or none\n";
+    std::cerr << "  --template-sim=<s>      : share of equal tokens for a line to join a template (default: 0.5)\n";
+    std::cerr << "  --template-params=<f>   : also write '<template id>\\t<values>' per line to f, the templates to f.templates\n";
+    std::cerr << "  --dedup                 : write each distinct line once as '<line>\\t<count>' (read by analyze --counts;\n";
+    std::cerr << "                            not with --regex)\n";
     std::cerr << "  --help                  : display this help message\n";
 }
 
@@ -34,16 +50,23 @@ int main(int argc, char** argv) {
     std::string inputFile  = argv[1];
     std::string outputFile = argv[2];
 
-    std::string regexPattern = "";
+    std::vector<std::string> regexPatterns;
     std::string ignoreChars  = "";
     std::string delimChars   = "";
+    RegexEngine regexEngine = REGEX_DFA;
+    unsigned threads = 1;
+    bool mineTemplates = false;
+    uint8_t masks = MASK_ALL;
+    double templateSimilarity = 0.5;
+    std::string paramsFile;
+    bool dedup = false;
 
 
     for (int i = 3; i < argc; i++) {
         std::string arg = argv[i];
 
         if (arg.rfind("--regex=", 0) == 0) {
-            regexPattern = arg.substr(8);
+            if (arg.size() > 8) regexPatterns.push_back(arg.substr(8));
         }
         else if (arg.rfind("--ignore=", 0) == 0) {
             ignoreChars = arg.substr(9);
@@ -51,15 +74,97 @@ int main(int argc, char** argv) {
         else if (arg.rfind("--delim=", 0) == 0) {
             delimChars = arg.substr(8);
         }
+        else if (arg.rfind("--threads=", 0) == 0) {
+            try {
+                threads = std::stoul(arg.substr(10));
+            } catch (...) {
+                std::cerr << "[ERROR] Invalid value for --threads: " << arg << std::endl;
+                return 1;
+            }
+        }
+        else if (arg.rfind("--regex-engine=", 0) == 0) {
+            std::string engine = arg.substr(15);
+            if (engine != "dfa" && engine != "std") {
+                std::cerr << "[ERROR] Invalid value for --regex-engine: " << arg << std::endl;
+                return 1;
+            }
+            regexEngine = engine == "std" ? REGEX_STD : REGEX_DFA;
+        }
+        else if (arg == "--dedup") {
+            dedup = true;
+        }
+        else if (arg == "--templates") {
+            mineTemplates = true;
+        }
+        else if (arg.rfind("--mask=", 0) == 0) {
+            if (!TemplateMiner::parseMasks(arg.substr(7), masks)) {
+                std::cerr << "[ERROR] Invalid value for --mask: " << arg << std::endl;
+                return 1;
+            }
+        }
+        else if (arg.rfind("--template-sim=", 0) == 0) {
+            try {
+                templateSimilarity = std::stod(arg.substr(15));
+            } catch (...) {
+                std::cerr << "[ERROR] Invalid value for --template-sim: " << arg << std::endl;
+                return 1;
+            }
+        }
+        else if (arg.rfind("--template-params=", 0) == 0) {
+            paramsFile = arg.substr(18);
+        }
+    }
+
+    // modes that cannot apply together are refused rather than silently dropped
+    if (!regexPatterns.empty() && (mineTemplates || dedup)) {
+        std::cerr << "[ERROR] --templates and --dedup cannot be combined with --regex" << std::endl;
+        return 1;
+    }
+    if (threads != 1 && (mineTemplates || dedup)) {
+        std::cerr << "[ERROR] --threads cannot be combined with --templates or --dedup, which run on one thread" << std::endl;
+        return 1;
     }
 
 
     Preprocessor pp(true);
 
-    if (!regexPattern.empty()) {
-        vector<string> cleaned = pp.filterByRegex(inputFile,  regexPattern);
-        pp.exportCollected(outputFile, cleaned);
-        cout << "Cleaned data exported to " << outputFile << endl;
+    if (!regexPatterns.empty()) {
+        for (const std::string& pattern : regexPatterns) {
+            Regex probe;
+            if (!probe.compile(pattern)) {
+                std::cerr << "[ERROR] Invalid regex: " << pattern << std::endl;
+                return 1;
+            }
+        }
+        pp.setRegexEngine(regexEngine);
+
+        // one output per pattern: <output file> alone, or <stem>.<k><extension> for the k-th of several
+        std::vector<std::string> outputs;
+        std::vector<ofstream> fouts(regexPatterns.size());
+        for (size_t k = 0; k < regexPatterns.size(); ++k) {
+            std::filesystem::path path(outputFile);
+            if (regexPatterns.size() > 1) path.replace_filename(path.stem().string() + "." + std::to_string(k + 1) + path.extension().string());
+            outputs.push_back(path.string());
+            fouts[k].open(outputs[k], ios::trunc | ios::binary);
+            if (!fouts[k].is_open()) {
+                std::cerr << "[ERROR] Cannot open output file at '" << outputs[k] << "'" << std::endl;
+                return 1;
+            }
+        }
+
+        LineReader reader;
+        if (!reader.open(inputFile)) {
+            std::cerr << "[ERROR] Cannot read input file at '" << inputFile << "'" << std::endl;
+            return 1;
+        }
+        // captures go straight to the output files, nothing is collected in memory; several
+        // patterns share one pass over the input
+        if (regexPatterns.size() == 1) pp.filterByRegex(reader, regexPatterns[0], [&](string_view capture) { pp.writeCollected(fouts[0], capture); });
+        else pp.filterByRegex(reader, regexPatterns, [&](size_t k, string_view capture) { pp.writeCollected(fouts[k], capture); });
+
+        for (size_t k = 0; k < outputs.size(); ++k) {
+            cout << "Cleaned data exported to " << outputs[k] << (regexPatterns.size() > 1 ? " (" + regexPatterns[k] + ")" : "") << endl;
+        }
         return 0;
     }
 
@@ -72,7 +177,77 @@ int main(int argc, char** argv) {
         pp.setDelimiters(delimChars);
     }
 
-    pp.processFile(inputFile, outputFile);
+    auto start = std::chrono::steady_clock::now();
+    bool done;
+    // --dedup: lines are counted instead of written, and written once at the end
+    LineCounter counter;
+    ofstream fout;
+    if (mineTemplates || dedup || threads == 1) {
+        fout.open(outputFile, ios::trunc | ios::binary);
+        if (!fout.is_open()) {
+            std::cerr << "[ERROR] Cannot open output file at '" << outputFile << "'" << std::endl;
+            return 1;
+        }
+    }
+    auto output = [&](string_view line) {
+        if (dedup) counter.add(line);
+        else fout << line << '\n';
+    };
+
+    if (mineTemplates) {
+        TemplateMiner miner(masks, templateSimilarity);
+        ofstream params;
+        if (!paramsFile.empty()) params.open(paramsFile, ios::trunc | ios::binary);
+        size_t lines = 0;
+        if (dedup && paramsFile.empty()) {
+            // every line of a template is counted as its final text: no per-line replay needed
+            done = pp.mineTemplates(inputFile, miner, [&](uint32_t, string_view) { ++lines; });
+            for (uint32_t id = 0; done && id < miner.size(); ++id) counter.add(miner.templateOf(id), miner.templateSize(id));
+        }
+        else {
+            done = (paramsFile.empty() || params.is_open())
+                && pp.writeTemplates(inputFile, miner, outputFile + ".spool", [&](string_view line) { output(line); ++lines; },
+                                     paramsFile.empty() ? Preprocessor::ParamSink() : [&](uint32_t id, const std::vector<string_view>& values) {
+                                         params << id;
+                                         for (string_view value : values) params << '\t' << value;
+                                         params << '\n';
+                                     });
+        }
+        if (done && !paramsFile.empty()) {
+            ofstream table(paramsFile + ".templates", ios::trunc | ios::binary);
+            for (uint32_t id = 0; id < miner.size(); ++id) table << id << '\t' << miner.templateSize(id) << '\t' << miner.templateOf(id) << '\n';
+            done = table.good();
+        }
+        if (done) cout << "Mined " << miner.size() << " templates from " << lines << " lines" << endl;
+    }
+    else if (dedup) {
+        // delimiters turn one input line into several cleaned lines, each counted
+        done = pp.processFile(inputFile, [&](string_view cleaned) {
+            size_t begin = 0;
+            while (begin < cleaned.size()) {
+                size_t end = std::min(cleaned.find('\n', begin), cleaned.size());
+                if (end > begin) counter.add(cleaned.substr(begin, end - begin));
+                begin = end + 1;
+            }
+        });
+    }
+    else if (threads == 1) {
+        // cleaned lines are written as they come instead of being collected first
+        done = pp.processFile(inputFile, [&](string_view cleaned) { fout << cleaned << '\n'; });
+    }
+    else done = pp.processFileParallel(inputFile, outputFile, threads);
+    if (done && dedup) {
+        counter.write(fout);
+        done = fout.good();
+        cout << "Deduplicated " << counter.total() << " lines into " << counter.size() << " distinct lines" << endl;
+    }
+    if (!done) {
+        std::cerr << "[ERROR] Cannot preprocess '" << inputFile << "' into '" << outputFile << "'" << std::endl;
+        return 1;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double megabytes = pp.bytesRead() / 1e6;
+    cout << "Cleaned " << megabytes << " MB in " << seconds << " s (" << megabytes / seconds << " MB/s)" << endl;
     cout << "Cleaned data exported to: " << outputFile << endl;
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,232 @@
+#include "Scorer.h"
+#include "Preprocessor.h"
+#include "LineReader.h"
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <filesystem>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+
+using namespace std;
+
+void printHelp() {
+    cout << "Usage: score <baseline_file> <input_file> [flags]\n\n"
+         << "Builds the baseline trie from <baseline_file> (cleaned lines, as for analyze), then scores\n"
+         << "every line of <input_file> against it and prints latency percentiles and throughput.\n\n"
+         << "Flags:\n"
+         << "  --perc-freq=<val>      Percentile threshold for Frequency (Low, default: 5)\n"
+         << "  --perc-len=<val>       Percentile threshold for Length (Low, default: 5)\n"
+         << "  --perc-entropy=<val>   Percentile threshold for Entropy (High, default: 95)\n"
+         << "  --tokens               Baseline trie over whitespace-separated tokens\n"
+         << "  --burst=<n>            Baseline trie with array-hash containers of up to n suffixes\n"
+         << "  --load                 <baseline_file> is a file written by analyze --dump\n"
+         << "  --output=<file>        Write the score of every line as CSV\n"
+         << "  --verify-baseline      Score <baseline_file> against itself first: every line must be found whole\n"
+         << "  --help                 Show this help message\n";
+}
+
+bool startsWith(const string& str, const string& prefix) {
+    return str.size() >= prefix.size() &&
+           str.compare(0, prefix.size(), prefix) == 0;
+}
+
+// Every line the baseline was built from must match it to its end with a nonzero count; catches
+// the scorer splitting or walking a line differently from how it was inserted
+bool verifyBaseline(const Scorer& scorer, const string& baselineFile) {
+    LineReader reader;
+    if (!reader.open(baselineFile)) {
+        cerr << "[ERROR] Cannot read baseline file '" << baselineFile << "'" << endl;
+        return false;
+    }
+    size_t lines = 0, mismatches = 0;
+    string_view line;
+    while (reader.next(line)) {
+        LineScore s = scorer.score(line);
+        if (s.length == 0) continue;
+        ++lines;
+        if (s.frequency == 0 || s.divergeDepth != s.length) {
+            if (++mismatches <= 5) {
+                cerr << "[ERROR] Baseline line " << lines << " scored as unknown (frequency " << s.frequency
+                     << ", depth " << s.divergeDepth << " of " << s.length << "): " << line << endl;
+            }
+        }
+    }
+    if (mismatches) {
+        cerr << "[ERROR] " << mismatches << " of " << lines << " baseline lines are not found in the baseline trie" << endl;
+        return false;
+    }
+    cout << "Baseline check passed: all " << lines << " lines found" << endl;
+    return true;
+}
+
+string escapeCSV(string_view s) {
+    if (s.find_first_of(",\"\n") == string_view::npos) return string(s);
+    string out = "\"";
+    for (char c : s) {
+        if (c == '"') out += '"';
+        out += c;
+    }
+    return out + '"';
+}
+
+int main(int argc, char *argv[]) {
+
+    cerr << "========== Score ==========" << endl;
+
+    if (argc == 2 && string(argv[1]) == "--help") {
+        printHelp();
+        return 0;
+    }
+    if (argc < 3) {
+        cerr << "[ERROR] Expect: score <baseline_file> <input_file> [flags]\nRun 'score --help' for usage info" << endl;
+        return 1;
+    }
+
+    string baselineFile = argv[1];
+    string inputFile = argv[2];
+    for (const string& file : { baselineFile, inputFile }) {
+        if (!filesystem::exists(file)) {
+            cerr << "[ERROR] Input file '" << file << "' does not exist" << endl;
+            return 1;
+        }
+    }
+
+    double valPercFreq = 5.0;
+    double valPercLen = 5.0;
+    double valPercEntropy = 95.0;
+    bool tokenMode = false;
+    unsigned burstThreshold = 0;
+    bool loadDump = false;
+    string outputFile;
+    bool doVerify = false;
+
+    for (int i = 3; i < argc; i++) {
+        string arg = argv[i];
+        try {
+            if (startsWith(arg, "--perc-freq="))         valPercFreq = stod(arg.substr(12));
+            else if (startsWith(arg, "--perc-len="))     valPercLen = stod(arg.substr(11));
+            else if (startsWith(arg, "--perc-entropy=")) valPercEntropy = stod(arg.substr(15));
+            else if (startsWith(arg, "--burst="))        burstThreshold = stoul(arg.substr(8));
+            else if (startsWith(arg, "--output="))       outputFile = arg.substr(9);
+            else if (arg == "--tokens")                  tokenMode = true;
+            else if (arg == "--load")                    loadDump = true;
+            else if (arg == "--verify-baseline")         doVerify = true;
+            else {
+                cerr << "[ERROR] Invalid flag: " << arg << "\nRun 'score --help' for usage info\n";
+                return 1;
+            }
+        } catch (...) {
+            cerr << "[ERROR] Invalid value: " << arg << endl;
+            return 1;
+        }
+    }
+    if (burstThreshold && tokenMode) {
+        cerr << "[ERROR] --burst is only supported for character tries" << endl;
+        return 1;
+    }
+    if (doVerify && loadDump) {
+        cerr << "[ERROR] --verify-baseline needs the baseline lines, not a dump" << endl;
+        return 1;
+    }
+
+    /* Baseline */
+    StatTrie trie;
+    SymbolTable symbols;
+    Analysis a(valPercFreq, valPercLen, valPercEntropy);
+    if (loadDump) {
+        if (!a.load(baselineFile)) return 1;
+        a.rebuildTrie(trie, symbols);
+    }
+    else {
+        LineReader reader;
+        string_view line;
+        if (!reader.open(baselineFile)) {
+            cerr << "[ERROR] Cannot read baseline file '" << baselineFile << "'" << endl;
+            return 1;
+        }
+        trie.setBurstThreshold(burstThreshold);
+        if (tokenMode) {
+            Preprocessor pp;
+            vector<Symbol> tokens;
+            trie.setSymbolTable(&symbols);
+            while (reader.next(line)) {
+                pp.tokenize(line, symbols, tokens);
+                trie.insert(tokens);
+            }
+        }
+        else while (reader.next(line)) trie.insert(line);
+        a.collectStatistics(&trie);
+    }
+
+    /* Lines to score, views into the mapped input */
+    LineReader input;
+    if (!input.open(inputFile)) {
+        cerr << "[ERROR] Cannot read input file '" << inputFile << "'" << endl;
+        return 1;
+    }
+    string_view buffer = input.content();
+    vector<string_view> lines;
+    for (string_view line; input.next(line); ) lines.push_back(line);
+    if (lines.empty()) {
+        cerr << "[ERROR] No line to score in '" << inputFile << "'" << endl;
+        return 1;
+    }
+
+    Scorer scorer(trie, a);
+    if (doVerify && !verifyBaseline(scorer, baselineFile)) return 1;
+
+    // latency: every line timed on its own
+    vector<double> latency(lines.size());
+    vector<LineScore> scores(lines.size());
+    for (size_t i = 0; i < lines.size(); ++i) {
+        auto start = chrono::steady_clock::now();
+        scores[i] = scorer.score(lines[i]);
+        latency[i] = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+    }
+
+    // throughput: the batch API over the whole buffer
+    vector<LineScore> batch;
+    auto start = chrono::steady_clock::now();
+    scorer.scoreBuffer(buffer, batch);
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    size_t flagged[3] = {};
+    for (const LineScore& s : scores) {
+        flagged[0] += (s.categories & FREQ_ANOMALY) != 0;
+        flagged[1] += (s.categories & LEN_ANOMALY) != 0;
+        flagged[2] += (s.categories & ENTROPY_ANOMALY) != 0;
+    }
+
+    sort(latency.begin(), latency.end());
+    auto percentile = [&](double p) { return latency[min(latency.size() - 1, (size_t)(p / 100 * latency.size()))]; };
+    cout << "Scored " << lines.size() << " lines\n"
+         << "- Latency per line (us): p50 = " << percentile(50) << ", p99 = " << percentile(99)
+         << ", max = " << latency.back() << '\n'
+         << "- Batch throughput: " << batch.size() / seconds << " lines/s\n"
+         << "- Flagged: " << flagged[0] << " frequency, " << flagged[1] << " length, " << flagged[2] << " entropy" << endl;
+
+    if (!outputFile.empty()) {
+        ofstream fout (outputFile, ios::trunc);
+        if (!fout.is_open()) {
+            cerr << "[ERROR] Failed to open output file " << outputFile << endl;
+            return 1;
+        }
+        fout << "String,Frequency,Known depth,Branch entropy,Length,Length frequency,Anomaly\n";
+        for (size_t i = 0; i < lines.size(); ++i) {
+            const LineScore& s = scores[i];
+            string status;
+            if (s.categories & FREQ_ANOMALY) status += "frequency/";
+            if (s.categories & LEN_ANOMALY) status += "length/";
+            if (s.categories & ENTROPY_ANOMALY) status += "entropy/";
+            if (!status.empty()) status.pop_back();
+            fout << escapeCSV(lines[i]) << ',' << s.frequency << ',' << s.divergeDepth << ','
+                 << s.branchEntropy << ',' << s.length << ',' << s.lengthFrequency << ',' << status << '\n';
+        }
+        cout << "Scores are saved at: " << outputFile << endl;
+    }
+    return 0;
+}
+
+// Compile: g++ -std=c++17 -pthread -Iinclude -o bin/score src/score.cpp src/Scorer.cpp src/Analysis.cpp src/StatTrie.cpp src/ArrayHash.cpp src/Entropy.cpp src/QuantileSketch.cpp src/TaskPool.cpp src/Preprocessor.cpp src/TemplateMiner.cpp src/Regex.cpp src/SymbolTable.cpp src/LineReader.cpp -lz
@@ -0,0 +1,197 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <filesystem>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include <sys/wait.h>
+
+using namespace std;
+
+void printHelp() {
+    cout << "Usage: stream_bench <analyze_binary> <input_file> [flags] [-- analyze flags]\n\n"
+         << "Runs '<analyze_binary> - <dir> --stream', feeds it <input_file> through a pipe and reads the\n"
+         << "NDJSON records back. Prints input throughput and end-to-end latency (line written to record read).\n\n"
+         << "Flags:\n"
+         << "  --rate=<n>             Write n lines per second (default: 0, as fast as analyze reads)\n"
+         << "  --help                 Show this help message\n";
+}
+
+bool startsWith(const string& str, const string& prefix) {
+    return str.size() >= prefix.size() &&
+           str.compare(0, prefix.size(), prefix) == 0;
+}
+
+bool writeAll(int fd, const char* data, size_t size) {
+    while (size) {
+        ssize_t n = write(fd, data, size);
+        if (n <= 0) return false;
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+
+    cerr << "========== Stream benchmark ==========" << endl;
+
+    if (argc == 2 && string(argv[1]) == "--help") {
+        printHelp();
+        return 0;
+    }
+    if (argc < 3) {
+        cerr << "[ERROR] Expect: stream_bench <analyze_binary> <input_file> [flags]\nRun 'stream_bench --help' for usage info" << endl;
+        return 1;
+    }
+
+    string analyzeBinary = argv[1];
+    string inputFile = argv[2];
+    double rate = 0;
+    vector<string> analyzeFlags;
+
+    for (int i = 3; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--") {
+            analyzeFlags.assign(argv + i + 1, argv + argc);
+            break;
+        }
+        try {
+            if (startsWith(arg, "--rate=")) rate = stod(arg.substr(7));
+            else {
+                cerr << "[ERROR] Invalid flag: " << arg << "\nRun 'stream_bench --help' for usage info\n";
+                return 1;
+            }
+        } catch (...) {
+            cerr << "[ERROR] Invalid value: " << arg << endl;
+            return 1;
+        }
+    }
+
+    ifstream fin (inputFile);
+    if (!fin.is_open()) {
+        cerr << "[ERROR] Cannot open input file at '" << inputFile << "'\n";
+        return 1;
+    }
+    vector<string> lines;
+    string line;
+    while (getline(fin, line)) lines.push_back(line + '\n');
+    if (lines.empty()) {
+        cerr << "[ERROR] No line to stream in '" << inputFile << "'" << endl;
+        return 1;
+    }
+
+    // analyze writes its batch outputs at end of input; they go to a scratch directory
+    filesystem::path outputDir = filesystem::temp_directory_path() / ("stream_bench_" + to_string(getpid()));
+    filesystem::create_directories(outputDir);
+
+    int toChild[2], fromChild[2];
+    if (pipe(toChild) != 0 || pipe(fromChild) != 0) {
+        cerr << "[ERROR] Cannot create pipes" << endl;
+        return 1;
+    }
+
+    vector<string> args = { analyzeBinary, "-", outputDir.string(), "--stream" };
+    args.insert(args.end(), analyzeFlags.begin(), analyzeFlags.end());
+
+    pid_t child = fork();
+    if (child < 0) {
+        cerr << "[ERROR] Cannot start " << analyzeBinary << endl;
+        return 1;
+    }
+    if (child == 0) {
+        dup2(toChild[0], STDIN_FILENO);
+        dup2(fromChild[1], STDOUT_FILENO);
+        close(toChild[0]); close(toChild[1]);
+        close(fromChild[0]); close(fromChild[1]);
+        vector<char*> argvChild;
+        for (string &a : args) argvChild.push_back(a.data());
+        argvChild.push_back(nullptr);
+        execv(analyzeBinary.c_str(), argvChild.data());
+        perror("execv");
+        _exit(127);
+    }
+    close(toChild[0]);
+    close(fromChild[1]);
+
+    // send time of every line, in ns since start; read back through the "seq" of each record
+    vector<atomic<int64_t>> sent(lines.size());
+    auto start = chrono::steady_clock::now();
+    auto elapsed = [&]() { return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count(); };
+    atomic<int64_t> writeDone (0);
+
+    thread writer([&]() {
+        string batch;
+        size_t first = 0;
+        for (size_t i = 0; i < lines.size(); ++i) {
+            if (rate > 0) {
+                this_thread::sleep_until(start + chrono::nanoseconds((int64_t)(i * 1e9 / rate)));
+                sent[i].store(elapsed(), memory_order_release);
+                if (!writeAll(toChild[1], lines[i].data(), lines[i].size())) break;
+                continue;
+            }
+            // unthrottled: lines are written in pipe-sized batches, stamped just before the write
+            batch += lines[i];
+            if (batch.size() >= 65536 || i + 1 == lines.size()) {
+                int64_t now = elapsed();
+                for (size_t j = first; j <= i; ++j) sent[j].store(now, memory_order_release);
+                if (!writeAll(toChild[1], batch.data(), batch.size())) break;
+                batch.clear();
+                first = i + 1;
+            }
+        }
+        writeDone.store(elapsed());
+        close(toChild[1]);
+    });
+
+    vector<double> latency;
+    FILE* records = fdopen(fromChild[0], "r");
+    char* record = nullptr;
+    size_t capacity = 0;
+    size_t malformed = 0;
+    while (getline(&record, &capacity, records) > 0) {
+        int64_t now = elapsed();
+        const char* seq = strstr(record, "\"seq\":");
+        size_t i = seq ? strtoull(seq + 6, nullptr, 10) : 0;
+        if (i == 0 || i > lines.size()) {
+            ++malformed;
+            continue;
+        }
+        latency.push_back((now - sent[i - 1].load(memory_order_acquire)) / 1e3);
+    }
+    free(record);
+    fclose(records);
+    writer.join();
+
+    int status = 0;
+    waitpid(child, &status, 0);
+    filesystem::remove_all(outputDir);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        cerr << "[ERROR] " << analyzeBinary << " failed" << endl;
+        return 1;
+    }
+
+    double seconds = writeDone.load() / 1e9;
+    cout << "Streamed " << lines.size() << " lines in " << seconds << " s\n"
+         << "- Input throughput: " << lines.size() / max(seconds, 1e-9) << " lines/s\n"
+         << "- Anomaly records: " << latency.size();
+    if (malformed) cout << " (" << malformed << " without a valid seq)";
+    cout << '\n';
+    if (!latency.empty()) {
+        sort(latency.begin(), latency.end());
+        auto percentile = [&](double p) { return latency[min(latency.size() - 1, (size_t)(p / 100 * latency.size()))]; };
+        cout << "- End-to-end latency (us): p50 = " << percentile(50) << ", p99 = " << percentile(99)
+             << ", max = " << latency.back() << '\n';
+    }
+    cout << flush;
+    return 0;
+}
+
+// Compile: g++ -std=c++17 -pthread -o bin/stream_bench src/stream_bench.cpp
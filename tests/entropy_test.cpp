@@ -0,0 +1,126 @@
+#include "StatTrie.h"
+#include "Entropy.h"
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+using namespace std;
+
+
+// The entropy aggregates the trie keeps up to date on insert and remove, and the entropy kernel,
+// against a recomputation from scratch with the per-child floating-point formula.
+
+namespace {
+
+    // on H, and on the sums relative to their size (a sum of c*log2(c) reaches 1e8 and beyond
+    // at the root, where a double only resolves about 1e-8)
+    const double TOLERANCE = 1e-9;
+
+    int failures = 0;
+
+    void expect (bool ok, const string &what) {
+        cout << (ok ? "[OK]    " : "[FAIL]  ") << what << endl;
+        if (!ok) ++failures;
+    }
+
+    string show (double x) {
+        ostringstream out;
+        out << x;
+        return out.str();
+    }
+
+    double referenceSum (const vector<unsigned> &counts) {
+        double sum = 0;
+        for (unsigned c : counts) if (c) sum += c * log2 ((double)c);
+        return sum;
+    }
+
+    double referenceEntropy (const vector<unsigned> &counts) {
+        double total = 0, h = 0;
+        for (unsigned c : counts) total += c;
+        for (unsigned c : counts) {
+            if (c == 0) continue;
+            double p = c / total;
+            h -= p * log2 (p);
+        }
+        return h;
+    }
+
+    // Largest relative |entropySum - recompute| and |H - reference H| over the real nodes of the trie
+    // (container views are computed from their counts on the fly and carry no aggregate)
+    void deviations (const StatTrie &trie, double &maxSum, double &maxEntropy, unsigned &nodes) {
+        maxSum = maxEntropy = 0;
+        nodes = 0;
+        vector<unsigned> counts;
+        trie.traverse ([&](const Node* node, const string&) {
+            if (node->count == 0) return;
+            counts.assign (1, node->countEnd());
+            for (const pair<const Symbol, Node*> &p : node->children) counts.push_back (p.second->count);
+            double reference = referenceSum (counts);
+            maxSum = max (maxSum, fabs (node->entropySum - reference) / max (1.0, reference));
+            maxEntropy = max (maxEntropy, fabs (entropy::localEntropy (node->count, node->entropySum) - referenceEntropy (counts)));
+            ++nodes;
+        });
+    }
+
+    // Random inserts (with repeats and counts), then removals of part of the words
+    void churn (StatTrie &trie, unsigned seed, const string &label) {
+        mt19937 rng (seed);
+        uniform_int_distribution<int> length (1, 10), letter (0, 7), repeat (1, 3000);
+        vector<string> words;
+        for (int i = 0; i < 20000; ++i) {
+            string word;
+            for (int n = length (rng); n > 0; --n) word.push_back ('a' + letter (rng));
+            if (i % 4 == 0) trie.insert (word, repeat (rng));
+            else trie.insert (word);
+            words.push_back (word);
+        }
+        double maxSum, maxEntropy;
+        unsigned nodes;
+        deviations (trie, maxSum, maxEntropy, nodes);
+        expect (maxSum < TOLERANCE && maxEntropy < TOLERANCE,
+                label + ": after inserts, " + to_string (nodes) + " nodes, max deviation " + show (maxSum) + " (sum, relative), " + show (maxEntropy) + " (entropy)");
+
+        shuffle (words.begin(), words.end(), rng);
+        for (size_t i = 0; i < words.size() / 2; ++i) trie.remove (words[i]);
+        deviations (trie, maxSum, maxEntropy, nodes);
+        expect (maxSum < TOLERANCE && maxEntropy < TOLERANCE,
+                label + ": after removals, " + to_string (nodes) + " nodes, max deviation " + show (maxSum) + " (sum, relative), " + show (maxEntropy) + " (entropy)");
+    }
+
+}
+
+
+int main() {
+    StatTrie plain;
+    churn (plain, 1, "character trie");
+
+    StatTrie burst;
+    burst.setBurstThreshold (16);
+    churn (burst, 2, "burst trie");
+
+    // the kernel on gathered counts, across the table bound and past the AVX2 block of eight
+    mt19937 rng (3);
+    double maxKernel = 0;
+    for (unsigned n = 1; n <= 40; ++n) {
+        for (unsigned range : { 10u, entropy::TABLE_SIZE, 1000000u }) {
+            uniform_int_distribution<unsigned> count (0, range);
+            vector<unsigned> counts (n);
+            for (unsigned &c : counts) c = count (rng);
+            double h = entropy::localEntropy (counts.data(), counts.size());
+            maxKernel = max (maxKernel, fabs (h - referenceEntropy (counts)));
+        }
+    }
+    expect (maxKernel < TOLERANCE, string ("kernel on gathered counts (AVX2 ") + (entropy::hasAVX2() ? "on" : "off") + "), max deviation " + show (maxKernel));
+
+    double maxLog = 0;
+    for (unsigned c = entropy::TABLE_SIZE; c < 50000000; c = c * 3 / 2 + 1)
+        maxLog = max (maxLog, fabs (entropy::fastLog2 (c) - log2 ((double)c)) / log2 ((double)c));
+    expect (maxLog < 1e-14, "fastLog2 relative error " + show (maxLog));
+
+    cout << (failures ? to_string (failures) + " check(s) failed" : "All checks passed") << endl;
+    return failures ? 1 : 0;
+}
+
+// Compile: g++ -std=c++17 -pthread -Iinclude -o bin/entropy_test tests/entropy_test.cpp src/StatTrie.cpp src/ArrayHash.cpp src/Entropy.cpp src/SymbolTable.cpp
@@ -0,0 +1,155 @@
+#include "Preprocessor.h"
+#include "LineReader.h"
+#include "Regex.h"
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+using namespace std;
+
+
+// The built-in regex automata against std::regex: the match spans of every line, then the
+// captures and time of Preprocessor::filterByRegex reading the lines through LineReader with
+// each engine, one pattern at a time and all of them in one pass. Without arguments the lines
+// are random ones made of each pattern's characters; `regex_test <input file> <pattern>...`
+// benchmarks the given patterns on a real input instead.
+
+namespace {
+
+    int failures = 0;
+
+    void expect (bool ok, const string &what) {
+        cout << (ok ? "[OK]    " : "[FAIL]  ") << what << endl;
+        if (!ok) ++failures;
+    }
+
+    // Count and FNV-1a hash of a sequence of captures, so long inputs are compared in O(1) memory
+    struct Digest {
+        size_t captures = 0;
+        uint64_t hash = 1469598103934665603ull;
+
+        void add (size_t pattern, string_view capture) {
+            ++captures;
+            for (unsigned char c : to_string (pattern) + '\t' + string (capture) + '\n') {
+                hash ^= c;
+                hash *= 1099511628211ull;
+            }
+        }
+        bool operator== (const Digest &other) const { return captures == other.captures && hash == other.hash; }
+    };
+
+    // filterByRegex over inputFile with the given engine, the time it took into seconds
+    bool run (Preprocessor &pp, RegexEngine engine, const string &inputFile, const vector<string> &patterns,
+              Digest &digest, double &seconds) {
+        pp.setRegexEngine (engine);
+        LineReader reader;
+        if (!reader.open (inputFile)) {
+            cerr << "[ERROR] Cannot read input file at '" << inputFile << "'" << endl;
+            return false;
+        }
+        auto start = chrono::steady_clock::now();
+        bool ok = patterns.size() == 1
+            ? pp.filterByRegex (reader, patterns[0], [&](string_view capture) { digest.add (0, capture); })
+            : pp.filterByRegex (reader, patterns, [&](size_t k, string_view capture) { digest.add (k, capture); });
+        seconds = chrono::duration<double> (chrono::steady_clock::now() - start).count();
+        return ok;
+    }
+
+    // Both engines on inputFile: equal captures, and their times
+    void compareEngines (Preprocessor &pp, const string &inputFile, const vector<string> &patterns, const string &label) {
+        Digest digests[2];
+        double seconds[2];
+        for (RegexEngine engine : { REGEX_STD, REGEX_DFA }) {
+            if (!run (pp, engine, inputFile, patterns, digests[engine], seconds[engine])) {
+                expect (false, label + ": filterByRegex failed");
+                return;
+            }
+        }
+        expect (digests[REGEX_STD] == digests[REGEX_DFA],
+                label + ": " + to_string (digests[REGEX_STD].captures) + " captures, std::regex " + to_string (seconds[REGEX_STD])
+                + " s, dfa " + to_string (seconds[REGEX_DFA]) + " s (" + to_string (seconds[REGEX_STD] / max (seconds[REGEX_DFA], 1e-9)) + "x)");
+    }
+
+    // Spans of the leftmost-first match of every line, built-in against std::regex
+    size_t compareSpans (const string &pattern, const vector<string> &lines) {
+        Regex builtin, reference;
+        builtin.compile (pattern, REGEX_DFA);
+        reference.compile (pattern, REGEX_STD);
+        vector<ptrdiff_t> spans, expected;
+        size_t mismatches = 0;
+        for (const string &line : lines) {
+            bool found = builtin.search (line, spans), wanted = reference.search (line, expected);
+            if ((found != wanted || (found && spans != expected)) && mismatches++ < 5)
+                cerr << "  /" << pattern << "/ differs on \"" << line << "\"" << endl;
+        }
+        return mismatches;
+    }
+
+}
+
+
+int main(int argc, char** argv) {
+    Preprocessor pp (true);
+
+    if (argc > 2) {
+        vector<string> patterns (argv + 2, argv + argc);
+        for (const string &pattern : patterns) {
+            Regex probe;
+            if (!probe.compile (pattern)) {
+                cerr << "[ERROR] Invalid regex: " << pattern << endl;
+                return 1;
+            }
+            cout << "/" << pattern << "/ " << (probe.builtin() ? "runs on the built-in automata" : "is outside the built-in subset, std::regex only") << endl;
+            compareEngines (pp, argv[1], { pattern }, "/" + pattern + "/ on " + string (argv[1]));
+        }
+        if (patterns.size() > 1) compareEngines (pp, argv[1], patterns, "all patterns in one pass on " + string (argv[1]));
+    }
+    else {
+        // patterns of the kind used on log lines, a few outside the built-in subset
+        vector<string> patterns = {
+            "(\\d+)", "ERROR.*", "user=(\\w+)", "(\\d{1,3}\\.){3}\\d{1,3}", "\\b(GET|POST)\\s+(\\S+)",
+            "^\\[(.*?)\\]", "a.*?b", "(a|ab)(c|bcd)(d*)", "[^ ]+@[a-z]+\\.(com|org)$", "\\Bin\\b",
+            "(x+x+)+y", "(\\w)\\1", "a(?=b)",
+        };
+        string file = (filesystem::temp_directory_path() / ("regex_test." + to_string (random_device()()) + ".txt")).string();
+        mt19937 rng (12345);
+        for (const string &pattern : patterns) {
+            string alphabet = pattern + " az09.@=[]";
+            vector<string> lines (20000);
+            for (string &line : lines)
+                for (unsigned n = rng() % 80; n--; ) line += alphabet[rng() % alphabet.size()];
+
+            Regex probe;
+            probe.compile (pattern);
+            size_t mismatches = compareSpans (pattern, lines);
+            expect (mismatches == 0, "/" + pattern + "/" + (probe.builtin() ? "" : " (std::regex only)") + ": match spans on "
+                    + to_string (lines.size()) + " lines, " + to_string (mismatches) + " mismatches");
+
+            ofstream out (file, ios::trunc | ios::binary);
+            for (const string &line : lines) out << line << '\n';
+            out.close();
+            compareEngines (pp, file, { pattern }, "/" + pattern + "/ through filterByRegex");
+        }
+
+        // all patterns in one pass, on lines mixing their characters
+        string alphabet = " az09.@=[]";
+        for (const string &pattern : patterns) alphabet += pattern;
+        ofstream out (file, ios::trunc | ios::binary);
+        for (int i = 0; i < 20000; ++i) {
+            for (unsigned n = rng() % 80; n--; ) out << alphabet[rng() % alphabet.size()];
+            out << '\n';
+        }
+        out.close();
+        compareEngines (pp, file, patterns, to_string (patterns.size()) + " patterns in one pass");
+        remove (file.c_str());
+    }
+
+    cout << (failures ? to_string (failures) + " check(s) failed" : "All checks passed") << endl;
+    return failures ? 1 : 0;
+}
+
+// Compile: g++ -std=c++17 -pthread -Iinclude -o bin/regex_test tests/regex_test.cpp src/Preprocessor.cpp src/TemplateMiner.cpp src/Regex.cpp src/SymbolTable.cpp src/LineReader.cpp src/TaskPool.cpp -lz
@@ -0,0 +1,155 @@
+#include "Preprocessor.h"
+#include "LineReader.h"
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+using namespace std;
+
+
+// Every SIMD path of Preprocessor::cleanLine (SSE4.2, AVX2, as far as the CPU has them) against
+// the scalar one, on lines built around the block edges: tails of 15/16/17 and 31/32/33 bytes,
+// special bytes and pairs of them at every position (so runs of spaces and delimiters, and a
+// held space, meet every block boundary), bytes >= 0x80, and random lines.
+// Lines of an input file given as argument are checked as well, under every configuration.
+
+namespace {
+
+    struct Config {
+        string name;
+        bool toLower;
+        string ignored, delimiters;
+    };
+
+    int failures = 0;
+
+    void expect (bool ok, const string &what) {
+        cout << (ok ? "[OK]    " : "[FAIL]  ") << what << endl;
+        if (!ok) ++failures;
+    }
+
+    string printable (string_view line) {
+        string out;
+        for (unsigned char c : line) {
+            if (c >= 0x20 && c < 0x7f) out += c;
+            else {
+                char hex[5];
+                snprintf (hex, sizeof hex, "\\x%02x", c);
+                out += hex;
+            }
+        }
+        return out;
+    }
+
+    struct Checker {
+        const Preprocessor &pp;
+        vector<SIMDLevel> levels;
+        size_t checked = 0, mismatches = 0;
+        string reference, cleaned;
+
+        Checker (const Preprocessor &pp, const vector<SIMDLevel> &levels) : pp (pp), levels (levels) {}
+
+        void operator() (string_view line) {
+            pp.cleanLine (line, reference, SIMD_NONE);
+            for (SIMDLevel level : levels) {
+                pp.cleanLine (line, cleaned, level);
+                if (cleaned != reference && mismatches++ < 5)
+                    cerr << "  level " << (int)level << " differs on \"" << printable (line) << "\": \""
+                         << printable (cleaned) << "\" instead of \"" << printable (reference) << "\"" << endl;
+            }
+            ++checked;
+        }
+    };
+
+    // Letters of both cases, so every block has bytes to lowercase
+    string letters (size_t n, size_t seed) {
+        string line;
+        for (size_t i = 0; i < n; ++i) line += (char)(((i + seed) % 3 ? 'a' : 'A') + (i * 7 + seed) % 26);
+        return line;
+    }
+
+}
+
+
+int main(int argc, char** argv) {
+    vector<Config> configs = {
+        { "lowercase", true, "", "" },
+        { "case kept", false, "", "" },
+        { "ignored and delimiters", true, "[]()\"'", ",;|" },
+        { "bytes >= 0x80 as specials", true, "\xa0\xff", "\x80" },
+    };
+
+    vector<SIMDLevel> levels;
+    for (SIMDLevel level : { SIMD_SSE42, SIMD_AVX2 })
+        if (level <= Preprocessor::simdLevel()) levels.push_back (level);
+    cout << "SIMD levels checked: " << levels.size() << " (up to " << (int)Preprocessor::simdLevel() << ")" << endl;
+
+    for (const Config &config : configs) {
+        Preprocessor pp (config.toLower);
+        if (!config.ignored.empty()) pp.setIgnoredCharacters (config.ignored);
+        if (!config.delimiters.empty()) pp.setDelimiters (config.delimiters);
+        Checker check (pp, levels);
+
+        // plain tails around the block sizes
+        for (size_t n = 0; n <= 70; ++n) check (letters (n, n));
+
+        // one or two special bytes at every position of every length up to two AVX2 blocks and more
+        string specials = " \t\n.\xc3\xa9\x80\xff" + config.ignored + config.delimiters;
+        for (size_t n = 1; n <= 70; ++n) {
+            for (size_t p = 0; p < n; ++p) {
+                for (char a : specials) {
+                    string line = letters (n, p);
+                    line[p] = a;
+                    check (line);
+                    if (p + 1 < n) {
+                        for (char b : specials) {
+                            line[p + 1] = b;
+                            check (line);
+                        }
+                    }
+                }
+            }
+        }
+
+        // a run of spaces or delimiters across the first boundaries, the held space included
+        for (size_t from = 12; from <= 34; ++from) {
+            for (size_t run = 1; run <= 6; ++run) {
+                for (char c : string (" ") + (config.delimiters.empty() ? "" : config.delimiters.substr (0, 1))) {
+                    string line = letters (80, from);
+                    for (size_t i = from; i < from + run; ++i) line[i] = c;
+                    check (line);
+                }
+            }
+        }
+
+        // random lines: mostly letters, with runs of spaces and the special characters mixed in
+        mt19937 rng (12345);
+        string line;
+        for (int i = 0; i < 50000; ++i) {
+            line.clear();
+            for (unsigned n = rng() % 160; n--; ) {
+                unsigned r = rng() % 16;
+                if (r < 3) line += specials[rng() % specials.size()];
+                else if (r < 5) line += ' ';
+                else line += (char)((rng() % 2 ? 'a' : 'A') + rng() % 26);
+            }
+            check (line);
+        }
+
+        if (argc > 1) {
+            LineReader reader;
+            if (!reader.open (argv[1])) {
+                cerr << "[ERROR] Cannot read input file at '" << argv[1] << "'" << endl;
+                return 1;
+            }
+            for (string_view view; reader.next (view); ) check (view);
+        }
+
+        expect (check.mismatches == 0, config.name + ": " + to_string (check.checked) + " lines, " + to_string (check.mismatches) + " mismatches");
+    }
+
+    cout << (failures ? to_string (failures) + " check(s) failed" : "All checks passed") << endl;
+    return failures ? 1 : 0;
+}
+
+// Compile: g++ -std=c++17 -pthread -Iinclude -o bin/simd_test tests/simd_test.cpp src/Preprocessor.cpp src/TemplateMiner.cpp src/Regex.cpp src/SymbolTable.cpp src/LineReader.cpp src/TaskPool.cpp -lz
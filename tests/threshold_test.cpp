@@ -0,0 +1,98 @@
+#include "Analysis.h"
+#include "Entropy.h"
+#include <iostream>
+#include <random>
+#include <string>
+#include <tuple>
+#include <vector>
+using namespace std;
+
+
+// Thresholds of the parallel collectStatistics against a single sketch filled in one serial pass
+// over the same entries, in entry (word) order: equal, exact or not. refreshThresholds merges its
+// task sketches without that reordering, so it is only held to the KLL rank error.
+
+namespace {
+
+    int failures = 0;
+
+    void expect (bool ok, const string &what) {
+        cout << (ok ? "[OK]    " : "[FAIL]  ") << what << endl;
+        if (!ok) ++failures;
+    }
+
+    // Words over a small alphabet (many shared prefixes), counts skewed towards 1
+    void fill (StatTrie &trie, unsigned words, unsigned seed) {
+        mt19937 rng (seed);
+        uniform_int_distribution<int> length (3, 12), letter (0, 5);
+        geometric_distribution<unsigned> count (0.3);
+        for (unsigned w = 0; w < words; ++w) {
+            string word;
+            for (int i = length (rng); i > 0; --i) word.push_back ('a' + letter (rng));
+            trie.insert (word, 1 + count (rng));
+        }
+    }
+
+    // (word, kind, value) of every entry, as collectStatistics makes them
+    vector<tuple<string, bool, double>> serialEntries (const StatTrie &trie) {
+        vector<tuple<string, bool, double>> entries;
+        trie.traverse ([&](const Node* node, const string &word) {
+            size_t outcomes = node->children.size() + (node->countEnd() > 0);
+            double h = outcomes < 2 ? 0 : entropy::localEntropy (node->count, node->entropySum);
+            if (h > 0) entries.emplace_back (word, false, h);
+            if (node->isEnd) entries.emplace_back (word, true, node->countEnd());
+        });
+        sort (entries.begin(), entries.end());
+        return entries;
+    }
+
+    // Distance from the percentile asked for to the ranks the estimate holds among the sorted
+    // values (a run of ties holds several), as a share of the values
+    double rankError (vector<double> values, double estimate, double percentile) {
+        sort (values.begin(), values.end());
+        double lo = (double)(lower_bound (values.begin(), values.end(), estimate) - values.begin()) / values.size();
+        double hi = (double)(upper_bound (values.begin(), values.end(), estimate) - values.begin()) / values.size();
+        return max ({ 0.0, lo - percentile / 100, percentile / 100 - hi });
+    }
+
+}
+
+
+int main() {
+    const double FREQ_P = 5, LEN_P = 5, ENTROPY_P = 95;
+
+    StatTrie trie;
+    fill (trie, 60000, 7);
+    vector<tuple<string, bool, double>> entries = serialEntries (trie);
+
+    for (size_t limit : { (size_t)1000, QuantileSketch::DEFAULT_EXACT_LIMIT }) {
+        QuantileSketch freq (limit), entropy (limit);
+        for (const tuple<string, bool, double> &e : entries) (get<1>(e) ? freq : entropy).add (get<2>(e));
+        double serialFreq = freq.quantile (FREQ_P), serialEntropy = entropy.quantile (ENTROPY_P);
+        string mode = freq.isExact() ? "exact" : "sketch";
+
+        for (unsigned threads : { 1u, 4u }) {
+            Analysis a (FREQ_P, LEN_P, ENTROPY_P);
+            a.setQuantileExactLimit (limit);
+            a.setThreads (threads);
+            a.collectStatistics (&trie);
+            string label = mode + ", " + to_string (threads) + " thread(s)";
+            expect (a.frequencyThreshold() == serialFreq, "frequency threshold equals the serial one (" + label + ")");
+            expect (a.localEntropyThreshold() == serialEntropy, "entropy threshold equals the serial one (" + label + ")");
+        }
+
+        Analysis a (FREQ_P, LEN_P, ENTROPY_P);
+        a.setQuantileExactLimit (limit);
+        a.refreshThresholds (&trie);
+        vector<double> freqs, entropies;
+        for (const tuple<string, bool, double> &e : entries) (get<1>(e) ? freqs : entropies).push_back (get<2>(e));
+        // KLL with k = 400 keeps the rank error well under 1%
+        expect (rankError (freqs, a.frequencyThreshold(), FREQ_P) <= 0.01, "refreshed frequency threshold within 1% rank (" + mode + ")");
+        expect (rankError (entropies, a.localEntropyThreshold(), ENTROPY_P) <= 0.01, "refreshed entropy threshold within 1% rank (" + mode + ")");
+    }
+
+    cout << (failures ? to_string (failures) + " check(s) failed" : "All checks passed") << endl;
+    return failures ? 1 : 0;
+}
+
+// Compile: g++ -std=c++17 -pthread -Iinclude -o bin/threshold_test tests/threshold_test.cpp src/Analysis.cpp src/StatTrie.cpp src/ArrayHash.cpp src/Entropy.cpp src/QuantileSketch.cpp src/TaskPool.cpp src/SymbolTable.cpp